@@ -4,6 +4,14 @@
 #include <algorithm>
 #include <numeric>
 #include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <type_traits>
+#include <chrono>
 
 class join_threads
 {
@@ -29,56 +37,328 @@ private:
 	std::vector<std::thread> &m_threads;
 };
 
-template <typename Iterator>
-void parallel_partial_sum(Iterator first, Iterator last)
+template <typename T>
+class thread_safe_queue
 {
-	using value_type = typename Iterator::value_type;
+public:
+	thread_safe_queue() = default;
+	~thread_safe_queue() = default;
+
+	void push(T data)
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		m_queue.push(std::move(data));
+	}
+
+	bool try_pop(T &value)
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		if (m_queue.empty())
+		{
+			return false;
+		}
+		value = std::move(m_queue.front());
+		m_queue.pop();
+		return true;
+	}
+
+private:
+	std::queue<T> m_queue;
+	mutable std::mutex m_mx;
+};
+
+class function_wrapper
+{
+public:
+	function_wrapper() = default;
+	template <typename F>
+	function_wrapper(F &&f)
+		: m_impl(std::make_unique<impl_type<F>>(std::move(f)))
+	{
+
+	}
+
+	function_wrapper(function_wrapper &&other)
+		: m_impl(std::move(other.m_impl))
+	{
+
+	}
+
+	function_wrapper &operator=(function_wrapper &&other)
+	{
+		m_impl = std::move(other.m_impl);
+		return *this;
+	}
+
+	function_wrapper(const function_wrapper&) = delete;
+	function_wrapper &operator=(const function_wrapper&) = delete;
+
+	void operator()()
+	{
+		m_impl->call();
+	}
+
+private:
+	struct impl_base
+	{
+	public:
+		virtual ~impl_base()
+		{
+
+		}
+		virtual void call() = 0;
+	};
+
+	std::unique_ptr<impl_base> m_impl;
+
+	template <typename F>
+	struct impl_type : public impl_base
+	{
+	public:
+		impl_type(F &&f)
+			: m_f(std::move(f))
+		{
+
+		}
+
+		void call()
+		{
+			m_f();
+		}
 
-	struct process_chunk
+		F m_f;
+	};
+};
+
+class work_stealing_queue
+{
+public:
+	work_stealing_queue() = default;
+	work_stealing_queue(const work_stealing_queue&) = delete;
+	work_stealing_queue &operator=(const work_stealing_queue&) = delete;
+
+	void push(function_wrapper data)
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		m_deque.push_front(std::move(data));
+	}
+
+	bool try_pop(function_wrapper &value)
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		if (m_deque.empty())
+		{
+			return false;
+		}
+
+		value = std::move(m_deque.front());
+		m_deque.pop_front();
+		return true;
+	}
+
+	bool try_steal(function_wrapper &value)
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		if (m_deque.empty())
+		{
+			return false;
+		}
+
+		value = std::move(m_deque.back());
+		m_deque.pop_back();
+		return true;
+	}
+
+private:
+	std::deque<function_wrapper> m_deque;
+	mutable std::mutex m_mutex;
+};
+
+class thread_pool
+{
+public:
+	explicit thread_pool(unsigned thread_count = std::max(std::thread::hardware_concurrency(), 1u))
+		: m_done(false), m_pending(0), m_sleepers(0), m_joiner(m_threads)
 	{
-		void operator()(Iterator begin,
-			Iterator last,
-			std::future<value_type> *previous_end_value,
-			std::promise<value_type> *end_value)
+		try
 		{
-			try
+			for (unsigned index = 0; index < thread_count; ++index)
 			{
-				Iterator end = last;
-				++end;
-				std::partial_sum(begin, end, begin);
-				if (previous_end_value != nullptr)
-				{
-					value_type add_end = previous_end_value->get();
-					*last += add_end;
-					if (end_value != nullptr)
-					{
-						end_value->set_value(*last);
-					}
-
-					std::for_each(begin, last, 
-					[add_end](value_type &item)
-					{
-						item += add_end;
-					});
-				}
-				else if (end_value != nullptr)
-				{
-					end_value->set_value(*last);
-				}
+				m_queues.push_back(std::make_unique<work_stealing_queue>());
 			}
-			catch (...)
+			for (unsigned index = 0; index < thread_count; ++index)
 			{
-				if (end_value != nullptr)
-				{
-					end_value->set_exception(std::current_exception());
-				}
-				else
-				{
-					throw;
-				}
+				m_threads.push_back(std::thread(&thread_pool::work_thread, this, index));
 			}
 		}
-	};
+		catch (...)
+		{
+			stop();
+			throw;
+		}
+	}
+
+	~thread_pool()
+	{
+		stop();
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool &operator=(const thread_pool&) = delete;
+
+	unsigned thread_count() const
+	{
+		return static_cast<unsigned>(m_queues.size());
+	}
+
+	template <typename FunctionType>
+	std::future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
+	{
+		using result_type = typename std::result_of<FunctionType()>::type;
+		std::packaged_task<result_type()> task(std::move(f));
+		std::future<result_type> res(task.get_future());
+		m_pending.fetch_add(1);
+		if ((sm_local_work_queue != nullptr) && (sm_owner == this))
+		{
+			sm_local_work_queue->push(std::move(task));
+		}
+		else
+		{
+			m_pool_work_queue.push(std::move(task));
+		}
+
+		if (m_sleepers.load() != 0)
+		{
+			std::lock_guard<std::mutex> lk(m_sleep_mutex);
+			m_sleep_cv.notify_one();
+		}
+
+		return res;
+	}
+
+	template <typename T>
+	void wait(std::future<T> &future)
+	{
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			run_pending_task();
+		}
+	}
+
+	void run_pending_task()
+	{
+		if (!try_run_pending_task())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+private:
+	std::atomic<bool> m_done;
+	std::atomic<unsigned> m_pending;
+	std::atomic<unsigned> m_sleepers;
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_sleep_cv;
+	thread_safe_queue<function_wrapper> m_pool_work_queue;
+	std::vector<std::unique_ptr<work_stealing_queue>> m_queues;
+	std::vector<std::thread> m_threads;
+	join_threads m_joiner;
+	static thread_local work_stealing_queue *sm_local_work_queue;
+	static thread_local const thread_pool *sm_owner;
+	static thread_local unsigned sm_my_index;
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_sleep_mutex);
+			m_done = true;
+		}
+		m_sleep_cv.notify_all();
+	}
+
+	void work_thread(unsigned my_index)
+	{
+		sm_my_index = my_index;
+		sm_owner = this;
+		sm_local_work_queue = m_queues[my_index].get();
+		while (!m_done)
+		{
+			if (!try_run_pending_task())
+			{
+				std::unique_lock<std::mutex> lk(m_sleep_mutex);
+				m_sleepers.fetch_add(1);
+				m_sleep_cv.wait(lk, [this] { return m_done || (m_pending.load() != 0); });
+				m_sleepers.fetch_sub(1);
+			}
+		}
+	}
+
+	bool try_run_pending_task()
+	{
+		function_wrapper task;
+		if (pop_task_from_local_queue(task)
+			|| pop_task_from_pool_queue(task)
+			|| pop_task_from_other_thread_queue(task))
+		{
+			m_pending.fetch_sub(1);
+			task();
+			return true;
+		}
+
+		return false;
+	}
+
+	bool pop_task_from_local_queue(function_wrapper &value)
+	{
+		return (sm_local_work_queue != nullptr) && (sm_owner == this) && sm_local_work_queue->try_pop(value);
+	}
+
+	bool pop_task_from_pool_queue(function_wrapper &value)
+	{
+		return m_pool_work_queue.try_pop(value);
+	}
+
+	bool pop_task_from_other_thread_queue(function_wrapper &value)
+	{
+		for (unsigned index = 0; index < m_queues.size(); ++index)
+		{
+			const unsigned tmp = (sm_my_index + index + 1) % m_queues.size();
+			if (m_queues[tmp]->try_steal(value))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+};
+
+thread_local work_stealing_queue *thread_pool::sm_local_work_queue = nullptr;
+thread_local const thread_pool *thread_pool::sm_owner = nullptr;
+thread_local unsigned thread_pool::sm_my_index = 0;
+
+thread_pool &default_executor()
+{
+	static thread_pool pool;
+	return pool;
+}
+
+template <typename Executor, typename T>
+void wait_for_all(Executor &executor, std::vector<std::future<T>> &futures)
+{
+	for (auto &future : futures)
+	{
+		if (future.valid())
+		{
+			executor.wait(future);
+		}
+	}
+}
+
+template <typename Iterator, typename Executor = thread_pool>
+void parallel_partial_sum(Iterator first, Iterator last, Executor &executor = default_executor())
+{
+	using value_type = typename Iterator::value_type;
 
 	const unsigned long length = std::distance(first, last);
 	if (length == 0)
@@ -88,33 +368,90 @@ void parallel_partial_sum(Iterator first, Iterator last)
 
 	const unsigned long min_per_thread = 25;
 	const unsigned long max_threads = (length + min_per_thread - 1) / min_per_thread;
-	const unsigned long hardware_threads = std::thread::hardware_concurrency();
-	const unsigned long num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
+	const unsigned long executor_threads = executor.thread_count() + 1;
+	const unsigned long num_threads = std::min(executor_threads, max_threads);
 	const unsigned long block_size = length / num_threads;
-	std::vector<std::thread> threads(num_threads - 1);
-	std::vector<std::promise<value_type>> end_values(num_threads - 1);
-	std::vector<std::future<value_type>> previous_end_values;
-	previous_end_values.reserve(num_threads - 1);
-	join_threads jt(threads);
+	std::vector<Iterator> block_starts;
+	std::vector<std::future<value_type>> block_totals;
+	block_starts.reserve(num_threads);
+	block_totals.reserve(num_threads - 1);
 
 	Iterator block_start = first;
-	for (unsigned long index = 0; index < (num_threads - 1); ++index)
+	try
 	{
-		auto block_last = block_start;
-		std::advance(block_last, block_size - 1);
-		threads[index] = std::thread(process_chunk(),
-			block_start, block_last,
-			(index != 0) ? &previous_end_values[index - 1] : nullptr, &end_values[index]);
+		for (unsigned long index = 0; index < (num_threads - 1); ++index)
+		{
+			Iterator block_end = block_start;
+			std::advance(block_end, block_size);
+			block_starts.push_back(block_start);
+			block_totals.push_back(executor.submit([block_start, block_end]
+			{
+				Iterator block_last = std::partial_sum(block_start, block_end, block_start);
+				return *--block_last;
+			}));
+
+			block_start = block_end;
+		}
 
-		block_start = block_last;
-		++block_start;
-		previous_end_values.push_back(end_values[index].get_future());
+		block_starts.push_back(block_start);
+		std::partial_sum(block_start, last, block_start);
 	}
+	catch (...)
+	{
+		wait_for_all(executor, block_totals);
+		throw;
+	}
+
+	wait_for_all(executor, block_totals);
+	std::vector<value_type> totals;
+	totals.reserve(block_totals.size());
+	for (auto &total : block_totals)
+	{
+		totals.push_back(total.get());
+	}
+
+	if (num_threads == 1)
+	{
+		return;
+	}
+
+	std::vector<std::future<void>> adjustments;
+	adjustments.reserve(num_threads - 2);
+	value_type offset = totals[0];
+	try
+	{
+		for (unsigned long index = 1; index < (num_threads - 1); ++index)
+		{
+			Iterator block_begin = block_starts[index];
+			Iterator block_end = block_starts[index + 1];
+			adjustments.push_back(executor.submit([block_begin, block_end, offset]
+			{
+				std::for_each(block_begin, block_end,
+				[offset](value_type &item)
+				{
+					item += offset;
+				});
+			}));
+			offset += totals[index];
+		}
 
-	auto final_element = block_start;
-	std::advance(final_element, std::distance(block_start, last) - 1);
-	process_chunk()(block_start, final_element,
-		(num_threads > 1) ? &previous_end_values.back() : nullptr, nullptr);
+		std::for_each(block_starts.back(), last,
+		[offset](value_type &item)
+		{
+			item += offset;
+		});
+	}
+	catch (...)
+	{
+		wait_for_all(executor, adjustments);
+		throw;
+	}
+
+	wait_for_all(executor, adjustments);
+	for (auto &adjustment : adjustments)
+	{
+		adjustment.get();
+	}
 }
 
 int main()
@@ -2,9 +2,13 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <queue>
 #include <functional>
 #include <iostream>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
 
 class join_threads
 {
@@ -66,13 +70,101 @@ private:
 	std::mutex m_mx;
 };
 
+class event_count
+{
+public:
+	event_count()
+		: m_waiters(0), m_epoch(0)
+	{
+
+	}
+
+	event_count(const event_count&) = delete;
+	event_count &operator=(const event_count&) = delete;
+
+	unsigned prepare_wait()
+	{
+		m_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_epoch.load(std::memory_order_acquire);
+	}
+
+	void cancel_wait()
+	{
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void wait(unsigned epoch)
+	{
+		{
+			std::unique_lock<std::mutex> lk(m_mutex);
+			m_cond.wait(lk, [&] { return m_epoch.load(std::memory_order_relaxed) != epoch; });
+		}
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void notify_one()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_one();
+	}
+
+	void notify_all()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_all();
+	}
+
+private:
+	std::atomic<unsigned> m_waiters;
+	std::atomic<unsigned> m_epoch;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	bool has_waiters() const
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_waiters.load(std::memory_order_relaxed) != 0;
+	}
+};
+
+enum class shutdown_mode
+{
+	drain,
+	abort
+};
+
+struct shutdown_result
+{
+	std::size_t m_tasks_run = 0;
+	std::size_t m_tasks_dropped = 0;
+	bool m_timed_out = false;
+};
+
 class thread_pool
 {
 public:
 	thread_pool()
-		: m_done(false), m_joiner(m_threads)
+		: m_done(false), m_draining(false), m_stopping(false), m_shutdown_runs(0), m_stopped(false),
+		m_live_workers(std::thread::hardware_concurrency()), m_joiner(m_threads)
 	{
-		const unsigned thread_count = std::thread::hardware_concurrency();
+		const unsigned thread_count = m_live_workers;
 		try
 		{
 			for (unsigned index = 0; index < thread_count; ++index)
@@ -89,35 +181,137 @@ public:
 
 	~thread_pool()
 	{
-		m_done = true;
+		shutdown(shutdown_mode::abort);
 	}
 
 	template <typename FunctionType>
 	void submit(FunctionType f)
 	{
+		if (m_done)
+		{
+			throw std::runtime_error("thread pool has been shut down");
+		}
+
 		m_work_queue.push(std::function<void()>(f));
+		m_work_event.notify_one();
+	}
+
+	shutdown_result shutdown(shutdown_mode mode, std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max())
+	{
+		std::lock_guard<std::mutex> lk(m_shutdown_mx);
+		shutdown_result result;
+		if (m_stopped)
+		{
+			return result;
+		}
+
+		m_stopping = true;
+		if (mode == shutdown_mode::drain)
+		{
+			m_draining = true;
+			m_work_event.notify_all();
+			result.m_timed_out = !wait_for_workers(timeout);
+		}
+
+		m_done = true;
+		m_work_event.notify_all();
+		for (auto &t : m_threads)
+		{
+			if (t.joinable())
+			{
+				t.join();
+			}
+		}
+		m_stopped = true;
+
+		result.m_tasks_run = m_shutdown_runs.load();
+		std::function<void()> task;
+		while (m_work_queue.try_pop(task))
+		{
+			++result.m_tasks_dropped;
+		}
+		return result;
 	}
 
 private:
+	static const unsigned sm_spin_count = 64;
+
 	std::atomic<bool> m_done;
+	std::atomic<bool> m_draining;
+	std::atomic<bool> m_stopping;
+	std::atomic<std::size_t> m_shutdown_runs;
+	std::mutex m_shutdown_mx;
+	bool m_stopped;
+	unsigned m_live_workers;
+	std::mutex m_exit_mx;
+	std::condition_variable m_exit_cv;
 	thread_safe_queue<std::function<void()>> m_work_queue;
+	event_count m_work_event;
 	std::vector<std::thread> m_threads;
 	join_threads m_joiner;
 
 	void work_thread()
 	{
+		unsigned idle_spins = 0;
 		while (!m_done)
 		{
 			std::function<void()> task;
 			if (m_work_queue.try_pop(task))
 			{
+				idle_spins = 0;
 				task();
+				if (m_stopping)
+				{
+					m_shutdown_runs.fetch_add(1, std::memory_order_relaxed);
+				}
 			}
-			else
+			else if (m_draining)
+			{
+				break;
+			}
+			else if (++idle_spins < sm_spin_count)
 			{
 				std::this_thread::yield();
 			}
+			else
+			{
+				idle_spins = 0;
+				wait_for_task();
+			}
+		}
+		worker_exited();
+	}
+
+	void worker_exited()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_exit_mx);
+			--m_live_workers;
 		}
+		m_exit_cv.notify_all();
+	}
+
+	bool wait_for_workers(std::chrono::steady_clock::duration timeout)
+	{
+		std::unique_lock<std::mutex> lk(m_exit_mx);
+		if (timeout == std::chrono::steady_clock::duration::max())
+		{
+			m_exit_cv.wait(lk, [this] { return m_live_workers == 0; });
+			return true;
+		}
+		return m_exit_cv.wait_for(lk, timeout, [this] { return m_live_workers == 0; });
+	}
+
+	void wait_for_task()
+	{
+		const unsigned epoch = m_work_event.prepare_wait();
+		if (m_done || m_draining || !m_work_queue.empty())
+		{
+			m_work_event.cancel_wait();
+			return;
+		}
+
+		m_work_event.wait(epoch);
 	}
 };
 
@@ -145,6 +339,7 @@ int main()
 	tp.submit(Test);
 	tp.submit(Test);
 
-	std::this_thread::sleep_for(std::chrono::seconds(20));
+	const shutdown_result result = tp.shutdown(shutdown_mode::drain, std::chrono::seconds(20));
+	std::cout << "ran " << result.m_tasks_run << ", dropped " << result.m_tasks_dropped << std::endl;
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <type_traits>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+class join_threads
+{
+public:
+	join_threads(std::vector<std::thread> &threads)
+		: m_threads(threads)
+	{
+
+	}
+
+	~join_threads()
+	{
+		for (auto &t : m_threads)
+		{
+			if (t.joinable())
+			{
+				t.join();
+			}
+		}
+	}
+private:
+	std::vector<std::thread> &m_threads;
+};
+
+template <typename T>
+class thread_safe_queue
+{
+public:
+	thread_safe_queue() = default;
+	~thread_safe_queue() = default;
+
+	void push(T data)
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		m_queue.push(std::move(data));
+	}
+
+	bool try_pop(T &value)
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		if (m_queue.empty())
+		{
+			return false;
+		}
+		value = std::move(m_queue.front());
+		m_queue.pop();
+		return true;
+	}
+
+	bool empty()
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		return m_queue.empty();
+	}
+
+protected:
+private:
+	std::queue<T> m_queue;
+	std::mutex m_mx;
+};
+
+template <std::size_t InlineSize>
+class basic_function_wrapper
+{
+public:
+	static_assert(InlineSize >= sizeof(void*), "inline storage must be able to hold a heap pointer");
+
+	template <typename F>
+	struct is_inline
+		: std::integral_constant<bool, (sizeof(F) <= InlineSize)
+			&& (alignof(F) <= alignof(std::max_align_t))
+			&& std::is_nothrow_move_constructible<F>::value>
+	{
+
+	};
+
+	basic_function_wrapper() = default;
+
+	template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, basic_function_wrapper>::value>::type>
+	basic_function_wrapper(F &&f)
+		: m_vtable(&callable<typename std::decay<F>::type>::sm_vtable)
+	{
+		callable<typename std::decay<F>::type>::construct(&m_storage, std::forward<F>(f));
+	}
+
+	basic_function_wrapper(basic_function_wrapper &&other) noexcept
+		: m_vtable(other.m_vtable)
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->move(&other.m_storage, &m_storage);
+			other.m_vtable = nullptr;
+		}
+	}
+
+	basic_function_wrapper &operator=(basic_function_wrapper &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			if (other.m_vtable != nullptr)
+			{
+				other.m_vtable->move(&other.m_storage, &m_storage);
+				m_vtable = other.m_vtable;
+				other.m_vtable = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	~basic_function_wrapper()
+	{
+		reset();
+	}
+
+	basic_function_wrapper(const basic_function_wrapper&) = delete;
+	basic_function_wrapper &operator=(const basic_function_wrapper&) = delete;
+
+	void operator()()
+	{
+		m_vtable->call(&m_storage);
+	}
+
+private:
+	struct vtable
+	{
+		void (*call)(void *storage);
+		void (*move)(void *from, void *to);
+		void (*destroy)(void *storage);
+	};
+
+	template <typename F, bool Inline = is_inline<F>::value>
+	struct callable
+	{
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			new (storage) F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(*static_cast<F*>(storage))();
+		}
+
+		static void move(void *from, void *to)
+		{
+			F *const f = static_cast<F*>(from);
+			new (to) F(std::move(*f));
+			f->~F();
+		}
+
+		static void destroy(void *storage)
+		{
+			static_cast<F*>(storage)->~F();
+		}
+
+		static const vtable sm_vtable;
+	};
+
+	template <typename F>
+	struct callable<F, false>
+	{
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			*static_cast<F**>(storage) = new F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(**static_cast<F**>(storage))();
+		}
+
+		static void move(void *from, void *to)
+		{
+			*static_cast<F**>(to) = *static_cast<F**>(from);
+		}
+
+		static void destroy(void *storage)
+		{
+			delete *static_cast<F**>(storage);
+		}
+
+		static const vtable sm_vtable;
+	};
+
+	const vtable *m_vtable = nullptr;
+	typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type m_storage;
+
+	void reset()
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->destroy(&m_storage);
+			m_vtable = nullptr;
+		}
+	}
+};
+
+template <std::size_t InlineSize>
+template <typename F, bool Inline>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, Inline>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+template <std::size_t InlineSize>
+template <typename F>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, false>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+using function_wrapper = basic_function_wrapper<48>;
+
+class event_count
+{
+public:
+	event_count()
+		: m_waiters(0), m_epoch(0)
+	{
+
+	}
+
+	event_count(const event_count&) = delete;
+	event_count &operator=(const event_count&) = delete;
+
+	unsigned prepare_wait()
+	{
+		m_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_epoch.load(std::memory_order_acquire);
+	}
+
+	void cancel_wait()
+	{
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void wait(unsigned epoch)
+	{
+		{
+			std::unique_lock<std::mutex> lk(m_mutex);
+			m_cond.wait(lk, [&] { return m_epoch.load(std::memory_order_relaxed) != epoch; });
+		}
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void notify_one()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_one();
+	}
+
+	void notify_all()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_all();
+	}
+
+private:
+	std::atomic<unsigned> m_waiters;
+	std::atomic<unsigned> m_epoch;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	bool has_waiters() const
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_waiters.load(std::memory_order_relaxed) != 0;
+	}
+};
+
+class yield_idle_policy
+{
+public:
+	template <typename Predicate>
+	void idle(unsigned &, Predicate)
+	{
+		std::this_thread::yield();
+	}
+
+	void notify_one()
+	{
+
+	}
+
+	void notify_all()
+	{
+
+	}
+};
+
+class parking_idle_policy
+{
+public:
+	template <typename Predicate>
+	void idle(unsigned &idle_spins, Predicate stop_waiting)
+	{
+		if (++idle_spins < sm_spin_count)
+		{
+			std::this_thread::yield();
+			return;
+		}
+
+		idle_spins = 0;
+		const unsigned epoch = m_event.prepare_wait();
+		if (stop_waiting())
+		{
+			m_event.cancel_wait();
+			return;
+		}
+
+		m_event.wait(epoch);
+	}
+
+	void notify_one()
+	{
+		m_event.notify_one();
+	}
+
+	void notify_all()
+	{
+		m_event.notify_all();
+	}
+
+private:
+	static const unsigned sm_spin_count = 64;
+
+	event_count m_event;
+};
+
+template <typename IdlePolicy>
+class thread_pool
+{
+public:
+	explicit thread_pool(unsigned thread_count = std::thread::hardware_concurrency())
+		: m_done(false), m_joiner(m_threads)
+	{
+		try
+		{
+			for (unsigned index = 0; index < thread_count; ++index)
+			{
+				m_threads.push_back(std::thread(&thread_pool::work_thread, this));
+			}
+		}
+		catch (...)
+		{
+			m_done = true;
+			m_idle_policy.notify_all();
+			throw;
+		}
+	}
+
+	~thread_pool()
+	{
+		m_done = true;
+		m_idle_policy.notify_all();
+	}
+
+	template <typename FunctionType>
+	std::future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
+	{
+		using result_type = typename std::result_of<FunctionType()>::type;
+		std::packaged_task<result_type()> task(std::move(f));
+		std::future<result_type> res(task.get_future());
+		m_work_queue.push(std::move(task));
+		m_idle_policy.notify_one();
+		return res;
+	}
+
+private:
+	std::atomic<bool> m_done;
+	thread_safe_queue<function_wrapper> m_work_queue;
+	IdlePolicy m_idle_policy;
+	std::vector<std::thread> m_threads;
+	join_threads m_joiner;
+
+	void work_thread()
+	{
+		unsigned idle_spins = 0;
+		while (!m_done)
+		{
+			function_wrapper task;
+			if (m_work_queue.try_pop(task))
+			{
+				idle_spins = 0;
+				task();
+			}
+			else
+			{
+				m_idle_policy.idle(idle_spins, [this] { return m_done || !m_work_queue.empty(); });
+			}
+		}
+	}
+};
+
+template <typename IdlePolicy>
+void run_benchmark(const char *name)
+{
+	const unsigned thread_count = std::max(std::thread::hardware_concurrency(), 2u);
+	const int latency_samples = 1000;
+	thread_pool<IdlePolicy> tp(thread_count);
+
+	const std::clock_t cpu_start = std::clock();
+	const auto wall_start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	const double cpu_seconds = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+	const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+	std::vector<double> latencies;
+	latencies.reserve(latency_samples);
+	for (int index = 0; index < latency_samples; ++index)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(500));
+		const auto submitted = std::chrono::steady_clock::now();
+		auto started = tp.submit([] { return std::chrono::steady_clock::now(); }).get();
+		latencies.push_back(std::chrono::duration<double, std::micro>(started - submitted).count());
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	std::cout << name << " (" << thread_count << " threads)" << std::endl;
+	std::cout << "  idle cpu: " << cpu_seconds / wall_seconds << " cores" << std::endl;
+	std::cout << "  submit-to-start p50: " << latencies[latencies.size() / 2] << "us"
+		<< ", p99: " << latencies[latencies.size() * 99 / 100] << "us"
+		<< ", max: " << latencies.back() << "us" << std::endl;
+}
+
+int main()
+{
+	run_benchmark<yield_idle_policy>("yield");
+	run_benchmark<parking_idle_policy>("parking");
+
+	return 0;
+}
\ No newline at end of file
@@ -3,10 +3,21 @@
 #include <thread>
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 #include <future>
 #include <vector>
 #include <iostream>
 #include <list>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <exception>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
 
 class join_threads
 {
@@ -68,76 +79,920 @@ private:
 	mutable std::mutex m_mx;
 };
 
-class function_wrapper
+template <std::size_t InlineSize>
+class basic_function_wrapper
 {
 public:
-	function_wrapper() = default;
+	static_assert(InlineSize >= sizeof(void*), "inline storage must be able to hold a heap pointer");
+
 	template <typename F>
-	function_wrapper(F &&f)
-		: m_impl(std::make_unique<impl_type<F>>(std::move(f)))
+	struct is_inline
+		: std::integral_constant<bool, (sizeof(F) <= InlineSize)
+			&& (alignof(F) <= alignof(std::max_align_t))
+			&& std::is_nothrow_move_constructible<F>::value>
 	{
 
-	}
+	};
+
+	basic_function_wrapper() = default;
 
-	function_wrapper(function_wrapper &&other)
-		: m_impl(std::move(other.m_impl))
+	template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, basic_function_wrapper>::value>::type>
+	basic_function_wrapper(F &&f)
+		: m_vtable(&callable<typename std::decay<F>::type>::sm_vtable)
 	{
+		callable<typename std::decay<F>::type>::construct(&m_storage, std::forward<F>(f));
+	}
 
+	basic_function_wrapper(basic_function_wrapper &&other) noexcept
+		: m_vtable(other.m_vtable)
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->move(&other.m_storage, &m_storage);
+			other.m_vtable = nullptr;
+		}
 	}
 
-	function_wrapper &operator=(function_wrapper &&other)
+	basic_function_wrapper &operator=(basic_function_wrapper &&other) noexcept
 	{
-		m_impl = std::move(other.m_impl);
+		if (this != &other)
+		{
+			reset();
+			if (other.m_vtable != nullptr)
+			{
+				other.m_vtable->move(&other.m_storage, &m_storage);
+				m_vtable = other.m_vtable;
+				other.m_vtable = nullptr;
+			}
+		}
 		return *this;
 	}
 
-	function_wrapper(const function_wrapper&) = delete;
-	function_wrapper &operator=(const function_wrapper&) = delete;
+	~basic_function_wrapper()
+	{
+		reset();
+	}
+
+	basic_function_wrapper(const basic_function_wrapper&) = delete;
+	basic_function_wrapper &operator=(const basic_function_wrapper&) = delete;
 
 	void operator()()
 	{
-		m_impl->call();
+		m_vtable->call(&m_storage);
 	}
 
 private:
-	struct impl_base
+	struct vtable
+	{
+		void (*call)(void *storage);
+		void (*move)(void *from, void *to);
+		void (*destroy)(void *storage);
+	};
+
+	template <typename F, bool Inline = is_inline<F>::value>
+	struct callable
+	{
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			new (storage) F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(*static_cast<F*>(storage))();
+		}
+
+		static void move(void *from, void *to)
+		{
+			F *const f = static_cast<F*>(from);
+			new (to) F(std::move(*f));
+			f->~F();
+		}
+
+		static void destroy(void *storage)
+		{
+			static_cast<F*>(storage)->~F();
+		}
+
+		static const vtable sm_vtable;
+	};
+
+	template <typename F>
+	struct callable<F, false>
 	{
-	public:
-		virtual ~impl_base()
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			*static_cast<F**>(storage) = new F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(**static_cast<F**>(storage))();
+		}
+
+		static void move(void *from, void *to)
 		{
+			*static_cast<F**>(to) = *static_cast<F**>(from);
+		}
+
+		static void destroy(void *storage)
+		{
+			delete *static_cast<F**>(storage);
+		}
 
+		static const vtable sm_vtable;
+	};
+
+	const vtable *m_vtable = nullptr;
+	typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type m_storage;
+
+	void reset()
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->destroy(&m_storage);
+			m_vtable = nullptr;
 		}
-		virtual void call() = 0;
+	}
+};
+
+template <std::size_t InlineSize>
+template <typename F, bool Inline>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, Inline>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+template <std::size_t InlineSize>
+template <typename F>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, false>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+using function_wrapper = basic_function_wrapper<48>;
+
+class event_count
+{
+public:
+	event_count()
+		: m_waiters(0), m_epoch(0)
+	{
+
+	}
+
+	event_count(const event_count&) = delete;
+	event_count &operator=(const event_count&) = delete;
+
+	unsigned prepare_wait()
+	{
+		m_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_epoch.load(std::memory_order_acquire);
+	}
+
+	void cancel_wait()
+	{
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void wait(unsigned epoch)
+	{
+		{
+			std::unique_lock<std::mutex> lk(m_mutex);
+			m_cond.wait(lk, [&] { return m_epoch.load(std::memory_order_relaxed) != epoch; });
+		}
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void notify_one()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_one();
+	}
+
+	void notify_all()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_all();
+	}
+
+private:
+	std::atomic<unsigned> m_waiters;
+	std::atomic<unsigned> m_epoch;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	bool has_waiters() const
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_waiters.load(std::memory_order_relaxed) != 0;
+	}
+};
+
+class task_state_allocator
+{
+public:
+	task_state_allocator() = default;
+	task_state_allocator(const task_state_allocator&) = delete;
+	task_state_allocator &operator=(const task_state_allocator&) = delete;
+
+	~task_state_allocator()
+	{
+		for (std::size_t index = 0; index < sm_size_classes; ++index)
+		{
+			while (m_free_blocks[index] != nullptr)
+			{
+				free_block *const block = m_free_blocks[index];
+				m_free_blocks[index] = block->m_next;
+				::operator delete(block);
+			}
+		}
+	}
+
+	static std::size_t block_size(std::size_t size)
+	{
+		return (size + sm_block_granularity - 1) / sm_block_granularity * sm_block_granularity;
+	}
+
+	void *allocate(std::size_t size)
+	{
+		const std::size_t size_class = block_size(size) / sm_block_granularity - 1;
+		if ((size_class < sm_size_classes) && (m_free_blocks[size_class] != nullptr))
+		{
+			free_block *const block = m_free_blocks[size_class];
+			m_free_blocks[size_class] = block->m_next;
+			--m_free_counts[size_class];
+			return block;
+		}
+
+		return ::operator new(block_size(size));
+	}
+
+	void deallocate(void *memory, std::size_t size)
+	{
+		const std::size_t size_class = block_size(size) / sm_block_granularity - 1;
+		if ((size_class < sm_size_classes) && (m_free_counts[size_class] < sm_max_cached_blocks))
+		{
+			free_block *const block = static_cast<free_block*>(memory);
+			block->m_next = m_free_blocks[size_class];
+			m_free_blocks[size_class] = block;
+			++m_free_counts[size_class];
+			return;
+		}
+
+		::operator delete(memory);
+	}
+
+private:
+	static const std::size_t sm_block_granularity = 64;
+	static const std::size_t sm_size_classes = 8;
+	static const std::size_t sm_max_cached_blocks = 256;
+
+	struct free_block
+	{
+		free_block *m_next;
 	};
 
-	std::unique_ptr<impl_base> m_impl;
+	free_block *m_free_blocks[sm_size_classes] = {};
+	std::size_t m_free_counts[sm_size_classes] = {};
+};
+
+thread_local task_state_allocator *this_thread_task_state_allocator = nullptr;
+
+void *allocate_task_state(std::size_t size)
+{
+	if (this_thread_task_state_allocator != nullptr)
+	{
+		return this_thread_task_state_allocator->allocate(size);
+	}
+
+	return ::operator new(task_state_allocator::block_size(size));
+}
+
+void deallocate_task_state(void *memory, std::size_t size)
+{
+	if (this_thread_task_state_allocator != nullptr)
+	{
+		this_thread_task_state_allocator->deallocate(memory, size);
+	}
+	else
+	{
+		::operator delete(memory);
+	}
+}
+
+const std::size_t task_completion_stripes = 64;
+
+event_count &task_completion_event(const void *key)
+{
+	static event_count completions[task_completion_stripes];
+	return completions[(reinterpret_cast<std::uintptr_t>(key) >> 6) % task_completion_stripes];
+}
+
+class pool_shutdown_error : public std::runtime_error
+{
+public:
+	pool_shutdown_error()
+		: std::runtime_error("thread pool has been shut down")
+	{
+
+	}
+};
+
+thread_local std::exception_ptr this_thread_drop_reason;
+
+class task_scheduler
+{
+public:
+	virtual ~task_scheduler() = default;
+	virtual void schedule(function_wrapper task) = 0;
+};
+
+class task_continuation
+{
+public:
+	task_continuation(function_wrapper task, task_scheduler *scheduler)
+		: m_task(std::move(task)), m_scheduler(scheduler)
+	{
+
+	}
+
+	void fire()
+	{
+		if (m_scheduler != nullptr)
+		{
+			m_scheduler->schedule(std::move(m_task));
+		}
+		else
+		{
+			m_task();
+		}
+		delete this;
+	}
+
+	static void fire_all(task_continuation *head)
+	{
+		task_continuation *ordered = nullptr;
+		while (head != nullptr)
+		{
+			task_continuation *const next = head->m_next;
+			head->m_next = ordered;
+			ordered = head;
+			head = next;
+		}
+
+		while (ordered != nullptr)
+		{
+			task_continuation *const next = ordered->m_next;
+			ordered->fire();
+			ordered = next;
+		}
+	}
+
+	static task_continuation *fired()
+	{
+		static task_continuation sentinel(function_wrapper(), nullptr);
+		return &sentinel;
+	}
+
+	void link(task_continuation *next)
+	{
+		m_next = next;
+	}
+
+private:
+	function_wrapper m_task;
+	task_scheduler *m_scheduler;
+	task_continuation *m_next = nullptr;
+};
+
+struct void_result
+{
+
+};
+
+template <typename T>
+class task_state
+{
+public:
+	using value_type = typename std::conditional<std::is_void<T>::value, void_result, T>::type;
+
+	static task_state *create(task_scheduler *scheduler)
+	{
+		return new (allocate_task_state(sizeof(task_state))) task_state(scheduler);
+	}
+
+	task_scheduler *scheduler() const
+	{
+		return m_scheduler;
+	}
+
+	void add_future_reference()
+	{
+		m_refs.store(2, std::memory_order_relaxed);
+	}
+
+	bool is_ready() const
+	{
+		return m_ready.load(std::memory_order_acquire);
+	}
+
+	void wait() const
+	{
+		event_count &completion = waiter_event();
+		while (!is_ready())
+		{
+			const unsigned epoch = completion.prepare_wait();
+			if (is_ready())
+			{
+				completion.cancel_wait();
+				return;
+			}
+
+			completion.wait(epoch);
+		}
+	}
+
+	template <typename... Args>
+	void set_value(Args&&... args)
+	{
+		new (&m_storage) value_type(std::forward<Args>(args)...);
+		m_has_value = true;
+		mark_ready();
+	}
+
+	void set_exception(std::exception_ptr exception)
+	{
+		m_exception = exception;
+		mark_ready();
+	}
+
+	value_type &value()
+	{
+		if (m_exception)
+		{
+			std::rethrow_exception(m_exception);
+		}
+
+		return *reinterpret_cast<value_type*>(&m_storage);
+	}
+
+	event_count &waiter_event() const
+	{
+		m_has_waiters.store(true, std::memory_order_relaxed);
+		return task_completion_event(this);
+	}
+
+	void set_continuation(task_continuation *continuation)
+	{
+		task_continuation *head = m_continuation.load(std::memory_order_acquire);
+		do
+		{
+			if (head == task_continuation::fired())
+			{
+				continuation->fire();
+				return;
+			}
+
+			continuation->link(head);
+		}
+		while (!m_continuation.compare_exchange_weak(head, continuation, std::memory_order_acq_rel, std::memory_order_acquire));
+	}
+
+	void release()
+	{
+		if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			this->~task_state();
+			deallocate_task_state(this, sizeof(task_state));
+		}
+	}
+
+private:
+	std::atomic<bool> m_ready;
+	mutable std::atomic<bool> m_has_waiters;
+	std::atomic<int> m_refs;
+	std::atomic<task_continuation*> m_continuation;
+	task_scheduler *const m_scheduler;
+	bool m_has_value = false;
+	std::exception_ptr m_exception;
+	typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type m_storage;
+
+	explicit task_state(task_scheduler *scheduler)
+		: m_ready(false), m_has_waiters(false), m_refs(1), m_continuation(nullptr), m_scheduler(scheduler)
+	{
+
+	}
+
+	~task_state()
+	{
+		if (m_has_value)
+		{
+			reinterpret_cast<value_type*>(&m_storage)->~value_type();
+		}
+	}
+
+	void mark_ready()
+	{
+		m_ready.store(true, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_has_waiters.load(std::memory_order_relaxed))
+		{
+			task_completion_event(this).notify_all();
+		}
+		task_continuation::fire_all(m_continuation.exchange(task_continuation::fired(), std::memory_order_acq_rel));
+	}
+};
+
+struct task_state_releaser
+{
+	template <typename State>
+	void operator()(State *state) const
+	{
+		state->release();
+	}
+};
+
+template <typename F>
+class pooled_task;
+
+template <typename F>
+pooled_task<F> make_pooled_task(F f, task_scheduler *scheduler = nullptr);
+
+template <typename T>
+class task_future;
+
+template <typename T>
+task_future<std::vector<task_future<T>>> when_all(std::vector<task_future<T>> futures);
+
+template <typename T>
+struct when_any_result
+{
+	std::size_t m_index;
+	std::vector<task_future<T>> m_futures;
+};
+
+template <typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures);
+
+template <typename T>
+class task_future
+{
+public:
+	task_future() = default;
+
+	task_future(task_future &&other) noexcept
+		: m_state(other.m_state)
+	{
+		other.m_state = nullptr;
+	}
+
+	task_future &operator=(task_future &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_state = other.m_state;
+			other.m_state = nullptr;
+		}
+		return *this;
+	}
+
+	~task_future()
+	{
+		reset();
+	}
+
+	task_future(const task_future&) = delete;
+	task_future &operator=(const task_future&) = delete;
+
+	bool valid() const
+	{
+		return m_state != nullptr;
+	}
+
+	bool is_ready() const
+	{
+		return m_state->is_ready();
+	}
+
+	void wait() const
+	{
+		m_state->wait();
+	}
+
+	T get()
+	{
+		m_state->wait();
+		std::unique_ptr<task_state<T>, task_state_releaser> state(m_state);
+		m_state = nullptr;
+		return take(*state);
+	}
 
 	template <typename F>
-	struct impl_type : public impl_base
+	task_future<typename std::result_of<F(task_future<T>)>::type> then(F fn)
 	{
-	public:
-		impl_type(F &&f)
-			: m_f(std::move(f))
+		task_state<T> *const state = m_state;
+		task_scheduler *const scheduler = state->scheduler();
+		auto task = make_pooled_task([fn = std::move(fn), future = std::move(*this)]() mutable
 		{
+			return fn(std::move(future));
+		}, scheduler);
+		auto res = task.get_future();
+		state->set_continuation(new task_continuation(std::move(task), scheduler));
+		return res;
+	}
 
+	std::future<T> to_std_future()
+	{
+		std::shared_ptr<std::promise<T>> promise = std::make_shared<std::promise<T>>();
+		std::future<T> res = promise->get_future();
+		task_state<T> *const state = m_state;
+		state->set_continuation(new task_continuation([promise, future = std::move(*this)]() mutable
+		{
+			try
+			{
+				fulfil(*promise, future);
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+			}
+		}, nullptr));
+		return res;
+	}
+
+private:
+	template <typename F>
+	friend class pooled_task;
+	template <typename U>
+	friend task_future<std::vector<task_future<U>>> when_all(std::vector<task_future<U>> futures);
+	template <typename U>
+	friend task_future<when_any_result<U>> when_any(std::vector<task_future<U>> futures);
+
+	task_state<T> *m_state = nullptr;
+
+	explicit task_future(task_state<T> *state)
+		: m_state(state)
+	{
+
+	}
+
+	template <typename U>
+	static U take(task_state<U> &state)
+	{
+		return std::move(state.value());
+	}
+
+	static void take(task_state<void> &state)
+	{
+		state.value();
+	}
+
+	template <typename U>
+	static void fulfil(std::promise<U> &promise, task_future<U> &future)
+	{
+		promise.set_value(future.get());
+	}
+
+	static void fulfil(std::promise<void> &promise, task_future<void> &future)
+	{
+		future.get();
+		promise.set_value();
+	}
+
+	void reset()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->release();
+			m_state = nullptr;
 		}
+	}
+};
+
+template <typename F>
+class pooled_task
+{
+public:
+	using result_type = typename std::result_of<F()>::type;
+
+	explicit pooled_task(F f, task_scheduler *scheduler = nullptr)
+		: m_f(std::move(f)), m_state(task_state<result_type>::create(scheduler))
+	{
 
-		void call()
+	}
+
+	pooled_task(pooled_task &&other) noexcept(std::is_nothrow_move_constructible<F>::value)
+		: m_f(std::move(other.m_f)), m_state(other.m_state)
+	{
+		other.m_state = nullptr;
+	}
+
+	~pooled_task()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->set_exception((this_thread_drop_reason != nullptr) ? this_thread_drop_reason
+				: std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+			m_state->release();
+		}
+	}
+
+	pooled_task(const pooled_task&) = delete;
+	pooled_task &operator=(const pooled_task&) = delete;
+	pooled_task &operator=(pooled_task&&) = delete;
+
+	task_future<result_type> get_future()
+	{
+		m_state->add_future_reference();
+		return task_future<result_type>(m_state);
+	}
+
+	void operator()()
+	{
+		run(std::is_void<result_type>());
+		m_state->release();
+		m_state = nullptr;
+	}
+
+private:
+	F m_f;
+	task_state<result_type> *m_state;
+
+	void run(std::false_type)
+	{
+		try
+		{
+			m_state->set_value(m_f());
+		}
+		catch (...)
+		{
+			m_state->set_exception(std::current_exception());
+		}
+	}
+
+	void run(std::true_type)
+	{
+		try
 		{
 			m_f();
+			m_state->set_value();
 		}
-			
-		F m_f;
+		catch (...)
+		{
+			m_state->set_exception(std::current_exception());
+		}
+	}
+};
+
+template <typename F>
+pooled_task<F> make_pooled_task(F f, task_scheduler *scheduler)
+{
+	return pooled_task<F>(std::move(f), scheduler);
+}
+
+template <typename T>
+task_future<std::vector<task_future<T>>> when_all(std::vector<task_future<T>> futures)
+{
+	struct when_all_state
+	{
+		std::vector<task_future<T>> m_futures;
+		std::atomic<std::size_t> m_remaining;
+		function_wrapper m_complete;
 	};
+
+	std::shared_ptr<when_all_state> shared = std::make_shared<when_all_state>();
+	when_all_state *const raw = shared.get();
+	task_scheduler *const scheduler = futures.empty() ? nullptr : futures.front().m_state->scheduler();
+	auto complete = make_pooled_task([raw] { return std::move(raw->m_futures); }, scheduler);
+	task_future<std::vector<task_future<T>>> res = complete.get_future();
+	shared->m_complete = std::move(complete);
+	shared->m_remaining.store(futures.size(), std::memory_order_relaxed);
+	std::vector<task_state<T>*> states;
+	states.reserve(futures.size());
+	for (auto &future : futures)
+	{
+		states.push_back(future.m_state);
+	}
+	shared->m_futures = std::move(futures);
+
+	if (states.empty())
+	{
+		shared->m_complete();
+		return res;
+	}
+
+	for (auto *state : states)
+	{
+		state->set_continuation(new task_continuation([shared]
+		{
+			if (shared->m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				shared->m_complete();
+			}
+		}, nullptr));
+	}
+
+	return res;
+}
+
+template <typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures)
+{
+	struct when_any_state
+	{
+		when_any_result<T> m_result;
+		std::atomic<bool> m_fired{ false };
+		std::atomic<int> m_gate{ 2 };
+		function_wrapper m_complete;
+
+		void arrive()
+		{
+			if (m_gate.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				m_complete();
+			}
+		}
+	};
+
+	std::shared_ptr<when_any_state> shared = std::make_shared<when_any_state>();
+	when_any_state *const raw = shared.get();
+	task_scheduler *const scheduler = futures.empty() ? nullptr : futures.front().m_state->scheduler();
+	auto complete = make_pooled_task([raw] { return std::move(raw->m_result); }, scheduler);
+	task_future<when_any_result<T>> res = complete.get_future();
+	shared->m_complete = std::move(complete);
+	std::vector<task_state<T>*> states;
+	states.reserve(futures.size());
+	for (auto &future : futures)
+	{
+		states.push_back(future.m_state);
+	}
+	shared->m_result.m_index = futures.size();
+	shared->m_result.m_futures = std::move(futures);
+
+	if (states.empty())
+	{
+		shared->m_complete();
+		return res;
+	}
+
+	for (std::size_t index = 0; index < states.size(); ++index)
+	{
+		states[index]->set_continuation(new task_continuation([shared, index]
+		{
+			if (!shared->m_fired.exchange(true, std::memory_order_acq_rel))
+			{
+				shared->m_result.m_index = index;
+				shared->arrive();
+			}
+		}, nullptr));
+	}
+	shared->arrive();
+
+	return res;
+}
+
+enum class shutdown_mode
+{
+	drain,
+	abort
+};
+
+struct shutdown_result
+{
+	std::size_t m_tasks_run = 0;
+	std::size_t m_tasks_dropped = 0;
+	bool m_timed_out = false;
 };
 
-class thread_pool
+class thread_pool : public task_scheduler
 {
 public:
 	thread_pool()
-		: m_done(false), m_joiner(m_threads)
+		: m_done(false), m_draining(false), m_stopping(false), m_shutdown_runs(0), m_stopped(false),
+		m_live_workers(std::thread::hardware_concurrency()), m_joiner(m_threads)
 	{
-		const unsigned thread_count = std::thread::hardware_concurrency();
+		const unsigned thread_count = m_live_workers;
 		try
 		{
 			for (unsigned index = 0; index < thread_count; ++index)
@@ -154,53 +1009,178 @@ public:
 
 	~thread_pool()
 	{
-		m_done = true;
+		shutdown(shutdown_mode::abort);
 	}
 
 
 	template <typename FunctionType>
-	std::future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
+	task_future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
 	{
 		using result_type = typename std::result_of<FunctionType()>::type;
-		std::packaged_task<result_type()> task(std::move(f));
-		std::future<result_type> res(task.get_future());
+		if (m_done)
+		{
+			throw pool_shutdown_error();
+		}
+
+		pooled_task<FunctionType> task(std::move(f), this);
+		task_future<result_type> res(task.get_future());
 		m_work_queue.push(std::move(task));
+		m_work_event.notify_one();
 		return res;
 	}
 
-	void run_pending_task()
+	void schedule(function_wrapper task) override
 	{
-		function_wrapper task;
-		if (m_work_queue.try_pop(task))
+		if (m_done)
 		{
 			task();
+			return;
 		}
-		else
+
+		m_work_queue.push(std::move(task));
+		m_work_event.notify_one();
+	}
+
+	shutdown_result shutdown(shutdown_mode mode, std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max())
+	{
+		std::lock_guard<std::mutex> lk(m_shutdown_mx);
+		shutdown_result result;
+		if (m_stopped)
+		{
+			return result;
+		}
+
+		m_stopping = true;
+		if (mode == shutdown_mode::drain)
+		{
+			m_draining = true;
+			m_work_event.notify_all();
+			result.m_timed_out = !wait_for_workers(timeout);
+		}
+
+		m_done = true;
+		m_work_event.notify_all();
+		for (auto &t : m_threads)
+		{
+			if (t.joinable())
+			{
+				t.join();
+			}
+		}
+		m_stopped = true;
+
+		result.m_tasks_run = m_shutdown_runs.load();
+		this_thread_drop_reason = std::make_exception_ptr(pool_shutdown_error());
+		function_wrapper task;
+		while (m_work_queue.try_pop(task))
+		{
+			task = function_wrapper();
+			++result.m_tasks_dropped;
+		}
+		this_thread_drop_reason = nullptr;
+		return result;
+	}
+
+	void run_pending_task()
+	{
+		if (!try_run_pending_task())
 		{
 			std::this_thread::yield();
 		}
 	}
 
 private:
+	static const unsigned sm_spin_count = 64;
+
 	std::atomic<bool> m_done;
+	std::atomic<bool> m_draining;
+	std::atomic<bool> m_stopping;
+	std::atomic<std::size_t> m_shutdown_runs;
+	std::mutex m_shutdown_mx;
+	bool m_stopped;
+	unsigned m_live_workers;
+	std::mutex m_exit_mx;
+	std::condition_variable m_exit_cv;
 	thread_safe_queue<function_wrapper> m_work_queue;
+	event_count m_work_event;
 	std::vector<std::thread> m_threads;
 	join_threads m_joiner;
 
+	bool try_run_pending_task()
+	{
+		function_wrapper task;
+		if (m_work_queue.try_pop(task))
+		{
+			task();
+			if (m_stopping)
+			{
+				m_shutdown_runs.fetch_add(1, std::memory_order_relaxed);
+			}
+			return true;
+		}
+
+		return false;
+	}
+
 	void work_thread()
 	{
+		task_state_allocator state_allocator;
+		this_thread_task_state_allocator = &state_allocator;
+		unsigned idle_spins = 0;
 		while (!m_done)
 		{
-			function_wrapper task;
-			if (m_work_queue.try_pop(task))
+			if (try_run_pending_task())
 			{
-				task();
+				idle_spins = 0;
 			}
-			else
+			else if (m_draining)
+			{
+				break;
+			}
+			else if (++idle_spins < sm_spin_count)
 			{
 				std::this_thread::yield();
 			}
+			else
+			{
+				idle_spins = 0;
+				wait_for_task();
+			}
 		}
+		this_thread_task_state_allocator = nullptr;
+		worker_exited();
+	}
+
+	void worker_exited()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_exit_mx);
+			--m_live_workers;
+		}
+		m_exit_cv.notify_all();
+	}
+
+	bool wait_for_workers(std::chrono::steady_clock::duration timeout)
+	{
+		std::unique_lock<std::mutex> lk(m_exit_mx);
+		if (timeout == std::chrono::steady_clock::duration::max())
+		{
+			m_exit_cv.wait(lk, [this] { return m_live_workers == 0; });
+			return true;
+		}
+		return m_exit_cv.wait_for(lk, timeout, [this] { return m_live_workers == 0; });
+	}
+
+	void wait_for_task()
+	{
+		const unsigned epoch = m_work_event.prepare_wait();
+		if (m_done || m_draining || !m_work_queue.empty())
+		{
+			m_work_event.cancel_wait();
+			return;
+		}
+
+		m_work_event.wait(epoch);
 	}
 };
 
@@ -225,11 +1205,11 @@ struct sorter
 		
 		std::list<T> new_lower_chunk;
 		new_lower_chunk.splice(new_lower_chunk.end(), chunk_data, chunk_data.begin(), divide_it);
-		std::future<std::list<T>> new_lower = m_tp.submit(std::bind(&sorter::do_sort, this, std::move(new_lower_chunk)));
+		task_future<std::list<T>> new_lower = m_tp.submit(std::bind(&sorter::do_sort, this, std::move(new_lower_chunk)));
 		std::list<T> new_higher(do_sort(chunk_data));
 		result.splice(result.end(), new_higher);
 
-		while (!(new_lower.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+		while (!new_lower.is_ready())
 		{
 			m_tp.run_pending_task();
 		}
@@ -3,10 +3,22 @@
 #include <thread>
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 #include <future>
 #include <vector>
 #include <iostream>
 #include <list>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <exception>
+#include <stdexcept>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
 
 class join_threads
 {
@@ -42,179 +54,2007 @@ public:
 	{
 		std::lock_guard<std::mutex> lk(m_mx);
 		m_queue.push(std::move(data));
+		note_depth();
+	}
+
+	void push_range(std::vector<T> &data)
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		for (auto &item : data)
+		{
+			m_queue.push(std::move(item));
+		}
+		note_depth();
+	}
+
+	bool try_push(T &data, std::size_t capacity)
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		if (m_queue.size() >= capacity)
+		{
+			return false;
+		}
+
+		m_queue.push(std::move(data));
+		note_depth();
+		return true;
+	}
+
+	bool try_pop(T &value)
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		if (m_queue.empty())
+		{
+			return false;
+		}
+		value = std::move(m_queue.front());
+		m_queue.pop();
+		return true;
+	}
+
+	bool empty()
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		return m_queue.empty();
+	}
+
+	std::size_t size()
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		return m_queue.size();
+	}
+
+	std::size_t high_water_mark() const
+	{
+		return m_high_water.load(std::memory_order_relaxed);
+	}
+
+protected:
+private:
+	std::queue<T> m_queue;
+	std::atomic<std::size_t> m_high_water{ 0 };
+	mutable std::mutex m_mx;
+
+	void note_depth()
+	{
+		if (m_queue.size() > m_high_water.load(std::memory_order_relaxed))
+		{
+			m_high_water.store(m_queue.size(), std::memory_order_relaxed);
+		}
+	}
+};
+
+template <typename T>
+class local_work_queue
+{
+public:
+	explicit local_work_queue(std::size_t capacity)
+		: m_ring(capacity), m_mask(capacity - 1), m_head(0), m_tail(0), m_has_next(false), m_next_streak(0)
+	{
+
+	}
+
+	local_work_queue(const local_work_queue&) = delete;
+	local_work_queue &operator=(const local_work_queue&) = delete;
+
+	bool full() const
+	{
+		return m_has_next && (m_tail - m_head == m_ring.size());
+	}
+
+	void push(T data)
+	{
+		if (m_has_next)
+		{
+			m_ring[m_tail & m_mask] = std::move(m_next);
+			++m_tail;
+		}
+		m_next = std::move(data);
+		m_has_next = true;
+	}
+
+	bool try_pop(T &value)
+	{
+		if (m_has_next && ((m_next_streak < sm_max_next_streak) || (m_head == m_tail)))
+		{
+			value = std::move(m_next);
+			m_has_next = false;
+			++m_next_streak;
+			return true;
+		}
+
+		if (m_head == m_tail)
+		{
+			return false;
+		}
+
+		value = std::move(m_ring[m_head & m_mask]);
+		++m_head;
+		m_next_streak = 0;
+		return true;
+	}
+
+	void take_oldest(std::size_t count, std::vector<T> &out)
+	{
+		for (; (count != 0) && (m_head != m_tail); --count)
+		{
+			out.push_back(std::move(m_ring[m_head & m_mask]));
+			++m_head;
+		}
+	}
+
+	std::size_t clear()
+	{
+		std::size_t cleared = size();
+		for (; m_head != m_tail; ++m_head)
+		{
+			m_ring[m_head & m_mask] = T();
+		}
+		m_next = T();
+		m_has_next = false;
+		return cleared;
+	}
+
+	bool empty() const
+	{
+		return !m_has_next && (m_head == m_tail);
+	}
+
+	std::size_t size() const
+	{
+		return (m_tail - m_head) + (m_has_next ? 1 : 0);
+	}
+
+	std::size_t capacity() const
+	{
+		return m_ring.size();
+	}
+
+private:
+	static const unsigned sm_max_next_streak = 32;
+
+	std::vector<T> m_ring;
+	const std::size_t m_mask;
+	std::size_t m_head;
+	std::size_t m_tail;
+	T m_next;
+	bool m_has_next;
+	unsigned m_next_streak;
+};
+
+const unsigned max_hazard_pointers = 256;
+const unsigned hazard_pointers_per_thread = 2;
+struct hazard_pointer
+{
+	std::atomic<std::thread::id> m_id;
+	std::atomic<void*> m_pointers[hazard_pointers_per_thread];
+};
+hazard_pointer g_hazard_pointers[max_hazard_pointers];
+
+class hp_owner
+{
+public:
+	hp_owner()
+		: m_hp(nullptr)
+	{
+		for (unsigned index = 0; index < max_hazard_pointers; ++index)
+		{
+			std::thread::id old_id;
+			if (g_hazard_pointers[index].m_id.compare_exchange_strong(old_id, std::this_thread::get_id()))
+			{
+				m_hp = &g_hazard_pointers[index];
+				break;
+			}
+		}
+
+		if (m_hp == nullptr)
+		{
+			throw std::runtime_error("No hazard pointers available");
+		}
+	}
+	hp_owner(const hp_owner&) = delete;
+	hp_owner &operator=(const hp_owner&) = delete;
+	~hp_owner()
+	{
+		for (auto &pointer : m_hp->m_pointers)
+		{
+			pointer.store(nullptr);
+		}
+		m_hp->m_id.store(std::thread::id());
+	}
+
+	std::atomic<void*> &get_pointer(unsigned slot)
+	{
+		return m_hp->m_pointers[slot];
+	}
+
+private:
+	hazard_pointer *m_hp;
+};
+
+std::atomic<void*> &get_hazard_pointer_for_current_thread(unsigned slot)
+{
+	thread_local static hp_owner hazard;
+	return hazard.get_pointer(slot);
+}
+
+bool outstanding_hazard_pointers_for(void *p)
+{
+	for (unsigned index = 0; index < max_hazard_pointers; ++index)
+	{
+		for (auto &pointer : g_hazard_pointers[index].m_pointers)
+		{
+			if (pointer.load() == p)
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+template <typename T>
+class injection_queue
+{
+public:
+	injection_queue()
+		: m_head(new segment), m_size(0), m_high_water(0), m_retired(nullptr)
+	{
+		m_tail.store(m_head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	~injection_queue()
+	{
+		T value;
+		while (try_pop(value))
+		{
+
+		}
+
+		segment *current = m_head.load(std::memory_order_relaxed);
+		while (current != nullptr)
+		{
+			segment *const next = current->m_next.load(std::memory_order_relaxed);
+			delete current;
+			current = next;
+		}
+		reclaim_retired_segments();
+	}
+
+	injection_queue(const injection_queue&) = delete;
+	injection_queue &operator=(const injection_queue&) = delete;
+
+	void push(T data)
+	{
+		note_depth(m_size.fetch_add(1, std::memory_order_relaxed) + 1);
+		std::atomic<void*> &hp = get_hazard_pointer_for_current_thread(sm_producer_slot);
+		segment *tail = protect(m_tail, hp);
+		for (;;)
+		{
+			const std::size_t index = tail->m_enqueue_index.fetch_add(1, std::memory_order_relaxed);
+			if (index < sm_segment_size)
+			{
+				tail->publish(index, data);
+				break;
+			}
+
+			tail = advance_tail(tail, hp);
+		}
+		hp.store(nullptr);
+	}
+
+	void push_range(std::vector<T> &data)
+	{
+		note_depth(m_size.fetch_add(data.size(), std::memory_order_relaxed) + data.size());
+		std::atomic<void*> &hp = get_hazard_pointer_for_current_thread(sm_producer_slot);
+		segment *tail = protect(m_tail, hp);
+		std::size_t pushed = 0;
+		while (pushed < data.size())
+		{
+			const std::size_t wanted = std::min(data.size() - pushed, sm_segment_size);
+			const std::size_t first = tail->m_enqueue_index.fetch_add(wanted, std::memory_order_relaxed);
+			if (first < sm_segment_size)
+			{
+				const std::size_t claimed = std::min(wanted, sm_segment_size - first);
+				for (std::size_t index = 0; index < claimed; ++index)
+				{
+					tail->publish(first + index, data[pushed + index]);
+				}
+				pushed += claimed;
+			}
+			if (pushed < data.size())
+			{
+				tail = advance_tail(tail, hp);
+			}
+		}
+		hp.store(nullptr);
+	}
+
+	bool try_push(T &data, std::size_t capacity)
+	{
+		if (size() >= capacity)
+		{
+			return false;
+		}
+
+		push(std::move(data));
+		return true;
 	}
 
 	bool try_pop(T &value)
 	{
-		std::lock_guard<std::mutex> lk(m_mx);
-		if (m_queue.empty())
+		return try_pop_batch(1, [&value](T &&popped) { value = std::move(popped); }) != 0;
+	}
+
+	template <typename Consumer>
+	std::size_t try_pop_batch(std::size_t max_count, Consumer consume)
+	{
+		std::atomic<void*> &hp = get_hazard_pointer_for_current_thread(sm_consumer_slot);
+		segment *head = protect(m_head, hp);
+		for (;;)
+		{
+			std::size_t index = head->m_dequeue_index.load(std::memory_order_relaxed);
+			if (index == sm_segment_size)
+			{
+				segment *const next = head->m_next.load(std::memory_order_acquire);
+				if (next == nullptr)
+				{
+					hp.store(nullptr);
+					return 0;
+				}
+
+				segment *expected = head;
+				m_tail.compare_exchange_strong(expected, next);
+				expected = head;
+				if (m_head.compare_exchange_strong(expected, next))
+				{
+					retire(head);
+				}
+				head = protect(m_head, hp);
+				continue;
+			}
+
+			const std::size_t limit = std::min(sm_segment_size, index + max_count);
+			std::size_t ready = index;
+			while ((ready < limit) && head->m_cells[ready].m_ready.load(std::memory_order_acquire))
+			{
+				++ready;
+			}
+			if (ready == index)
+			{
+				hp.store(nullptr);
+				return 0;
+			}
+
+			if (head->m_dequeue_index.compare_exchange_weak(index, ready, std::memory_order_relaxed))
+			{
+				m_size.fetch_sub(ready - index, std::memory_order_relaxed);
+				for (std::size_t cell = index; cell < ready; ++cell)
+				{
+					consume(head->take(cell));
+				}
+				hp.store(nullptr);
+				return ready - index;
+			}
+		}
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	std::size_t size() const
+	{
+		return m_size.load(std::memory_order_relaxed);
+	}
+
+	std::size_t high_water_mark() const
+	{
+		return m_high_water.load(std::memory_order_relaxed);
+	}
+
+private:
+	static const std::size_t sm_segment_size = 1024;
+	static const unsigned sm_producer_slot = 0;
+	static const unsigned sm_consumer_slot = 1;
+
+	struct cell
+	{
+		std::atomic<bool> m_ready{ false };
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+	};
+
+	struct segment
+	{
+		std::atomic<std::size_t> m_enqueue_index{ 0 };
+		char m_pad0[64 - sizeof(std::atomic<std::size_t>)];
+		std::atomic<std::size_t> m_dequeue_index{ 0 };
+		char m_pad1[64 - sizeof(std::atomic<std::size_t>)];
+		std::atomic<segment*> m_next{ nullptr };
+		segment *m_next_retired = nullptr;
+		cell m_cells[sm_segment_size];
+
+		void publish(std::size_t index, T &data)
+		{
+			new (&m_cells[index].m_storage) T(std::move(data));
+			m_cells[index].m_ready.store(true, std::memory_order_release);
+		}
+
+		T take(std::size_t index)
+		{
+			T *const stored = reinterpret_cast<T*>(&m_cells[index].m_storage);
+			T value(std::move(*stored));
+			stored->~T();
+			return value;
+		}
+	};
+
+	std::atomic<segment*> m_head;
+	char m_pad0[64 - sizeof(std::atomic<segment*>)];
+	std::atomic<segment*> m_tail;
+	char m_pad1[64 - sizeof(std::atomic<segment*>)];
+	std::atomic<std::size_t> m_size;
+	char m_pad2[64 - sizeof(std::atomic<std::size_t>)];
+	std::atomic<std::size_t> m_high_water;
+	std::atomic<segment*> m_retired;
+
+	static segment *protect(const std::atomic<segment*> &source, std::atomic<void*> &hp)
+	{
+		segment *current = source.load();
+		for (;;)
+		{
+			hp.store(current);
+			segment *const confirmed = source.load();
+			if (confirmed == current)
+			{
+				return current;
+			}
+			current = confirmed;
+		}
+	}
+
+	segment *advance_tail(segment *tail, std::atomic<void*> &hp)
+	{
+		segment *next = tail->m_next.load(std::memory_order_acquire);
+		if (next == nullptr)
+		{
+			segment *const fresh = new segment;
+			if (tail->m_next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel))
+			{
+				next = fresh;
+			}
+			else
+			{
+				delete fresh;
+			}
+		}
+
+		m_tail.compare_exchange_strong(tail, next);
+		return protect(m_tail, hp);
+	}
+
+	void retire(segment *old_segment)
+	{
+		old_segment->m_next_retired = m_retired.load(std::memory_order_relaxed);
+		while (!m_retired.compare_exchange_weak(old_segment->m_next_retired, old_segment, std::memory_order_release, std::memory_order_relaxed))
+		{
+
+		}
+		reclaim_retired_segments();
+	}
+
+	void reclaim_retired_segments()
+	{
+		segment *current = m_retired.exchange(nullptr, std::memory_order_acquire);
+		while (current != nullptr)
+		{
+			segment *const next = current->m_next_retired;
+			if (outstanding_hazard_pointers_for(current))
+			{
+				current->m_next_retired = m_retired.load(std::memory_order_relaxed);
+				while (!m_retired.compare_exchange_weak(current->m_next_retired, current, std::memory_order_release, std::memory_order_relaxed))
+				{
+
+				}
+			}
+			else
+			{
+				delete current;
+			}
+			current = next;
+		}
+	}
+
+	void note_depth(std::size_t current)
+	{
+		std::size_t high_water = m_high_water.load(std::memory_order_relaxed);
+		while ((current > high_water) && !m_high_water.compare_exchange_weak(high_water, current, std::memory_order_relaxed))
+		{
+
+		}
+	}
+};
+
+template <typename T>
+const std::size_t injection_queue<T>::sm_segment_size;
+
+template <std::size_t InlineSize>
+class basic_function_wrapper
+{
+public:
+	static_assert(InlineSize >= sizeof(void*), "inline storage must be able to hold a heap pointer");
+
+	template <typename F>
+	struct is_inline
+		: std::integral_constant<bool, (sizeof(F) <= InlineSize)
+			&& (alignof(F) <= alignof(std::max_align_t))
+			&& std::is_nothrow_move_constructible<F>::value>
+	{
+
+	};
+
+	basic_function_wrapper() = default;
+
+	template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, basic_function_wrapper>::value>::type>
+	basic_function_wrapper(F &&f)
+		: m_vtable(&callable<typename std::decay<F>::type>::sm_vtable)
+	{
+		callable<typename std::decay<F>::type>::construct(&m_storage, std::forward<F>(f));
+	}
+
+	basic_function_wrapper(basic_function_wrapper &&other) noexcept
+		: m_vtable(other.m_vtable)
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->move(&other.m_storage, &m_storage);
+			other.m_vtable = nullptr;
+		}
+	}
+
+	basic_function_wrapper &operator=(basic_function_wrapper &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			if (other.m_vtable != nullptr)
+			{
+				other.m_vtable->move(&other.m_storage, &m_storage);
+				m_vtable = other.m_vtable;
+				other.m_vtable = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	~basic_function_wrapper()
+	{
+		reset();
+	}
+
+	basic_function_wrapper(const basic_function_wrapper&) = delete;
+	basic_function_wrapper &operator=(const basic_function_wrapper&) = delete;
+
+	void operator()()
+	{
+		m_vtable->call(&m_storage);
+	}
+
+private:
+	struct vtable
+	{
+		void (*call)(void *storage);
+		void (*move)(void *from, void *to);
+		void (*destroy)(void *storage);
+	};
+
+	template <typename F, bool Inline = is_inline<F>::value>
+	struct callable
+	{
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			new (storage) F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(*static_cast<F*>(storage))();
+		}
+
+		static void move(void *from, void *to)
+		{
+			F *const f = static_cast<F*>(from);
+			new (to) F(std::move(*f));
+			f->~F();
+		}
+
+		static void destroy(void *storage)
+		{
+			static_cast<F*>(storage)->~F();
+		}
+
+		static const vtable sm_vtable;
+	};
+
+	template <typename F>
+	struct callable<F, false>
+	{
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			*static_cast<F**>(storage) = new F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(**static_cast<F**>(storage))();
+		}
+
+		static void move(void *from, void *to)
+		{
+			*static_cast<F**>(to) = *static_cast<F**>(from);
+		}
+
+		static void destroy(void *storage)
+		{
+			delete *static_cast<F**>(storage);
+		}
+
+		static const vtable sm_vtable;
+	};
+
+	const vtable *m_vtable = nullptr;
+	typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type m_storage;
+
+	void reset()
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->destroy(&m_storage);
+			m_vtable = nullptr;
+		}
+	}
+};
+
+template <std::size_t InlineSize>
+template <typename F, bool Inline>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, Inline>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+template <std::size_t InlineSize>
+template <typename F>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, false>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+using function_wrapper = basic_function_wrapper<48>;
+
+class event_count
+{
+public:
+	event_count()
+		: m_waiters(0), m_epoch(0)
+	{
+
+	}
+
+	event_count(const event_count&) = delete;
+	event_count &operator=(const event_count&) = delete;
+
+	unsigned prepare_wait()
+	{
+		m_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_epoch.load(std::memory_order_acquire);
+	}
+
+	void cancel_wait()
+	{
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void wait(unsigned epoch)
+	{
+		{
+			std::unique_lock<std::mutex> lk(m_mutex);
+			m_cond.wait(lk, [&] { return m_epoch.load(std::memory_order_relaxed) != epoch; });
+		}
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void notify_one()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_one();
+	}
+
+	void notify_all()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_all();
+	}
+
+private:
+	std::atomic<unsigned> m_waiters;
+	std::atomic<unsigned> m_epoch;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	bool has_waiters() const
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_waiters.load(std::memory_order_relaxed) != 0;
+	}
+};
+
+class task_state_allocator
+{
+public:
+	task_state_allocator() = default;
+	task_state_allocator(const task_state_allocator&) = delete;
+	task_state_allocator &operator=(const task_state_allocator&) = delete;
+
+	~task_state_allocator()
+	{
+		for (std::size_t index = 0; index < sm_size_classes; ++index)
+		{
+			while (m_free_blocks[index] != nullptr)
+			{
+				free_block *const block = m_free_blocks[index];
+				m_free_blocks[index] = block->m_next;
+				::operator delete(block);
+			}
+		}
+	}
+
+	static std::size_t block_size(std::size_t size)
+	{
+		return (size + sm_block_granularity - 1) / sm_block_granularity * sm_block_granularity;
+	}
+
+	void *allocate(std::size_t size)
+	{
+		const std::size_t size_class = block_size(size) / sm_block_granularity - 1;
+		if ((size_class < sm_size_classes) && (m_free_blocks[size_class] != nullptr))
+		{
+			free_block *const block = m_free_blocks[size_class];
+			m_free_blocks[size_class] = block->m_next;
+			--m_free_counts[size_class];
+			return block;
+		}
+
+		return ::operator new(block_size(size));
+	}
+
+	void deallocate(void *memory, std::size_t size)
+	{
+		const std::size_t size_class = block_size(size) / sm_block_granularity - 1;
+		if ((size_class < sm_size_classes) && (m_free_counts[size_class] < sm_max_cached_blocks))
+		{
+			free_block *const block = static_cast<free_block*>(memory);
+			block->m_next = m_free_blocks[size_class];
+			m_free_blocks[size_class] = block;
+			++m_free_counts[size_class];
+			return;
+		}
+
+		::operator delete(memory);
+	}
+
+private:
+	static const std::size_t sm_block_granularity = 64;
+	static const std::size_t sm_size_classes = 8;
+	static const std::size_t sm_max_cached_blocks = 256;
+
+	struct free_block
+	{
+		free_block *m_next;
+	};
+
+	free_block *m_free_blocks[sm_size_classes] = {};
+	std::size_t m_free_counts[sm_size_classes] = {};
+};
+
+thread_local task_state_allocator *this_thread_task_state_allocator = nullptr;
+
+void *allocate_task_state(std::size_t size)
+{
+	if (this_thread_task_state_allocator != nullptr)
+	{
+		return this_thread_task_state_allocator->allocate(size);
+	}
+
+	return ::operator new(task_state_allocator::block_size(size));
+}
+
+void deallocate_task_state(void *memory, std::size_t size)
+{
+	if (this_thread_task_state_allocator != nullptr)
+	{
+		this_thread_task_state_allocator->deallocate(memory, size);
+	}
+	else
+	{
+		::operator delete(memory);
+	}
+}
+
+const std::size_t task_completion_stripes = 64;
+
+event_count &task_completion_event(const void *key)
+{
+	static event_count completions[task_completion_stripes];
+	return completions[(reinterpret_cast<std::uintptr_t>(key) >> 6) % task_completion_stripes];
+}
+
+class pool_shutdown_error : public std::runtime_error
+{
+public:
+	pool_shutdown_error()
+		: std::runtime_error("thread pool has been shut down")
+	{
+
+	}
+};
+
+class pool_queue_full_error : public std::runtime_error
+{
+public:
+	pool_queue_full_error()
+		: std::runtime_error("thread pool queue is full")
+	{
+
+	}
+};
+
+thread_local std::exception_ptr this_thread_drop_reason;
+
+class task_scheduler
+{
+public:
+	virtual ~task_scheduler() = default;
+	virtual void schedule(function_wrapper task) = 0;
+};
+
+class task_continuation
+{
+public:
+	task_continuation(function_wrapper task, task_scheduler *scheduler)
+		: m_task(std::move(task)), m_scheduler(scheduler)
+	{
+
+	}
+
+	void fire()
+	{
+		if (m_scheduler != nullptr)
+		{
+			m_scheduler->schedule(std::move(m_task));
+		}
+		else
+		{
+			m_task();
+		}
+		delete this;
+	}
+
+	static void fire_all(task_continuation *head)
+	{
+		task_continuation *ordered = nullptr;
+		while (head != nullptr)
+		{
+			task_continuation *const next = head->m_next;
+			head->m_next = ordered;
+			ordered = head;
+			head = next;
+		}
+
+		while (ordered != nullptr)
+		{
+			task_continuation *const next = ordered->m_next;
+			ordered->fire();
+			ordered = next;
+		}
+	}
+
+	static task_continuation *fired()
+	{
+		static task_continuation sentinel(function_wrapper(), nullptr);
+		return &sentinel;
+	}
+
+	void link(task_continuation *next)
+	{
+		m_next = next;
+	}
+
+private:
+	function_wrapper m_task;
+	task_scheduler *m_scheduler;
+	task_continuation *m_next = nullptr;
+};
+
+struct void_result
+{
+
+};
+
+template <typename T>
+class task_state
+{
+public:
+	using value_type = typename std::conditional<std::is_void<T>::value, void_result, T>::type;
+
+	static task_state *create(task_scheduler *scheduler)
+	{
+		return new (allocate_task_state(sizeof(task_state))) task_state(scheduler);
+	}
+
+	task_scheduler *scheduler() const
+	{
+		return m_scheduler;
+	}
+
+	void add_future_reference()
+	{
+		m_refs.store(2, std::memory_order_relaxed);
+	}
+
+	bool is_ready() const
+	{
+		return m_ready.load(std::memory_order_acquire);
+	}
+
+	void wait() const
+	{
+		event_count &completion = waiter_event();
+		while (!is_ready())
+		{
+			const unsigned epoch = completion.prepare_wait();
+			if (is_ready())
+			{
+				completion.cancel_wait();
+				return;
+			}
+
+			completion.wait(epoch);
+		}
+	}
+
+	template <typename... Args>
+	void set_value(Args&&... args)
+	{
+		new (&m_storage) value_type(std::forward<Args>(args)...);
+		m_has_value = true;
+		mark_ready();
+	}
+
+	void set_exception(std::exception_ptr exception)
+	{
+		m_exception = exception;
+		mark_ready();
+	}
+
+	value_type &value()
+	{
+		if (m_exception)
+		{
+			std::rethrow_exception(m_exception);
+		}
+
+		return *reinterpret_cast<value_type*>(&m_storage);
+	}
+
+	event_count &waiter_event() const
+	{
+		m_has_waiters.store(true, std::memory_order_relaxed);
+		return task_completion_event(this);
+	}
+
+	void set_continuation(task_continuation *continuation)
+	{
+		task_continuation *head = m_continuation.load(std::memory_order_acquire);
+		do
+		{
+			if (head == task_continuation::fired())
+			{
+				continuation->fire();
+				return;
+			}
+
+			continuation->link(head);
+		}
+		while (!m_continuation.compare_exchange_weak(head, continuation, std::memory_order_acq_rel, std::memory_order_acquire));
+	}
+
+	void release()
+	{
+		if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			this->~task_state();
+			deallocate_task_state(this, sizeof(task_state));
+		}
+	}
+
+private:
+	std::atomic<bool> m_ready;
+	mutable std::atomic<bool> m_has_waiters;
+	std::atomic<int> m_refs;
+	std::atomic<task_continuation*> m_continuation;
+	task_scheduler *const m_scheduler;
+	bool m_has_value = false;
+	std::exception_ptr m_exception;
+	typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type m_storage;
+
+	explicit task_state(task_scheduler *scheduler)
+		: m_ready(false), m_has_waiters(false), m_refs(1), m_continuation(nullptr), m_scheduler(scheduler)
+	{
+
+	}
+
+	~task_state()
+	{
+		if (m_has_value)
+		{
+			reinterpret_cast<value_type*>(&m_storage)->~value_type();
+		}
+	}
+
+	void mark_ready()
+	{
+		m_ready.store(true, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_has_waiters.load(std::memory_order_relaxed))
+		{
+			task_completion_event(this).notify_all();
+		}
+		task_continuation::fire_all(m_continuation.exchange(task_continuation::fired(), std::memory_order_acq_rel));
+	}
+};
+
+struct task_state_releaser
+{
+	template <typename State>
+	void operator()(State *state) const
+	{
+		state->release();
+	}
+};
+
+template <typename F>
+class pooled_task;
+
+template <typename F>
+pooled_task<F> make_pooled_task(F f, task_scheduler *scheduler = nullptr);
+
+template <typename T>
+class task_future;
+
+template <typename T>
+task_future<std::vector<task_future<T>>> when_all(std::vector<task_future<T>> futures);
+
+template <typename T>
+struct when_any_result
+{
+	std::size_t m_index;
+	std::vector<task_future<T>> m_futures;
+};
+
+template <typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures);
+
+template <typename T>
+class task_future
+{
+public:
+	task_future() = default;
+
+	task_future(task_future &&other) noexcept
+		: m_state(other.m_state)
+	{
+		other.m_state = nullptr;
+	}
+
+	task_future &operator=(task_future &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_state = other.m_state;
+			other.m_state = nullptr;
+		}
+		return *this;
+	}
+
+	~task_future()
+	{
+		reset();
+	}
+
+	task_future(const task_future&) = delete;
+	task_future &operator=(const task_future&) = delete;
+
+	bool valid() const
+	{
+		return m_state != nullptr;
+	}
+
+	bool is_ready() const
+	{
+		return m_state->is_ready();
+	}
+
+	void wait() const
+	{
+		m_state->wait();
+	}
+
+	T get()
+	{
+		m_state->wait();
+		std::unique_ptr<task_state<T>, task_state_releaser> state(m_state);
+		m_state = nullptr;
+		return take(*state);
+	}
+
+	template <typename F>
+	task_future<typename std::result_of<F(task_future<T>)>::type> then(F fn)
+	{
+		task_state<T> *const state = m_state;
+		task_scheduler *const scheduler = state->scheduler();
+		auto task = make_pooled_task([fn = std::move(fn), future = std::move(*this)]() mutable
+		{
+			return fn(std::move(future));
+		}, scheduler);
+		auto res = task.get_future();
+		state->set_continuation(new task_continuation(std::move(task), scheduler));
+		return res;
+	}
+
+	std::future<T> to_std_future()
+	{
+		std::shared_ptr<std::promise<T>> promise = std::make_shared<std::promise<T>>();
+		std::future<T> res = promise->get_future();
+		task_state<T> *const state = m_state;
+		state->set_continuation(new task_continuation([promise, future = std::move(*this)]() mutable
+		{
+			try
+			{
+				fulfil(*promise, future);
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+			}
+		}, nullptr));
+		return res;
+	}
+
+private:
+	template <typename F>
+	friend class pooled_task;
+	template <typename U>
+	friend task_future<std::vector<task_future<U>>> when_all(std::vector<task_future<U>> futures);
+	template <typename U>
+	friend task_future<when_any_result<U>> when_any(std::vector<task_future<U>> futures);
+
+	task_state<T> *m_state = nullptr;
+
+	explicit task_future(task_state<T> *state)
+		: m_state(state)
+	{
+
+	}
+
+	template <typename U>
+	static U take(task_state<U> &state)
+	{
+		return std::move(state.value());
+	}
+
+	static void take(task_state<void> &state)
+	{
+		state.value();
+	}
+
+	template <typename U>
+	static void fulfil(std::promise<U> &promise, task_future<U> &future)
+	{
+		promise.set_value(future.get());
+	}
+
+	static void fulfil(std::promise<void> &promise, task_future<void> &future)
+	{
+		future.get();
+		promise.set_value();
+	}
+
+	void reset()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->release();
+			m_state = nullptr;
+		}
+	}
+};
+
+template <typename F>
+class pooled_task
+{
+public:
+	using result_type = typename std::result_of<F()>::type;
+
+	explicit pooled_task(F f, task_scheduler *scheduler = nullptr)
+		: m_f(std::move(f)), m_state(task_state<result_type>::create(scheduler))
+	{
+
+	}
+
+	pooled_task(pooled_task &&other) noexcept(std::is_nothrow_move_constructible<F>::value)
+		: m_f(std::move(other.m_f)), m_state(other.m_state)
+	{
+		other.m_state = nullptr;
+	}
+
+	~pooled_task()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->set_exception((this_thread_drop_reason != nullptr) ? this_thread_drop_reason
+				: std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+			m_state->release();
+		}
+	}
+
+	pooled_task(const pooled_task&) = delete;
+	pooled_task &operator=(const pooled_task&) = delete;
+	pooled_task &operator=(pooled_task&&) = delete;
+
+	task_future<result_type> get_future()
+	{
+		m_state->add_future_reference();
+		return task_future<result_type>(m_state);
+	}
+
+	void operator()()
+	{
+		run(std::is_void<result_type>());
+		m_state->release();
+		m_state = nullptr;
+	}
+
+private:
+	F m_f;
+	task_state<result_type> *m_state;
+
+	void run(std::false_type)
+	{
+		try
+		{
+			m_state->set_value(m_f());
+		}
+		catch (...)
+		{
+			m_state->set_exception(std::current_exception());
+		}
+	}
+
+	void run(std::true_type)
+	{
+		try
+		{
+			m_f();
+			m_state->set_value();
+		}
+		catch (...)
+		{
+			m_state->set_exception(std::current_exception());
+		}
+	}
+};
+
+template <typename F>
+pooled_task<F> make_pooled_task(F f, task_scheduler *scheduler)
+{
+	return pooled_task<F>(std::move(f), scheduler);
+}
+
+template <typename T>
+task_future<std::vector<task_future<T>>> when_all(std::vector<task_future<T>> futures)
+{
+	struct when_all_state
+	{
+		std::vector<task_future<T>> m_futures;
+		std::atomic<std::size_t> m_remaining;
+		function_wrapper m_complete;
+	};
+
+	std::shared_ptr<when_all_state> shared = std::make_shared<when_all_state>();
+	when_all_state *const raw = shared.get();
+	task_scheduler *const scheduler = futures.empty() ? nullptr : futures.front().m_state->scheduler();
+	auto complete = make_pooled_task([raw] { return std::move(raw->m_futures); }, scheduler);
+	task_future<std::vector<task_future<T>>> res = complete.get_future();
+	shared->m_complete = std::move(complete);
+	shared->m_remaining.store(futures.size(), std::memory_order_relaxed);
+	std::vector<task_state<T>*> states;
+	states.reserve(futures.size());
+	for (auto &future : futures)
+	{
+		states.push_back(future.m_state);
+	}
+	shared->m_futures = std::move(futures);
+
+	if (states.empty())
+	{
+		shared->m_complete();
+		return res;
+	}
+
+	for (auto *state : states)
+	{
+		state->set_continuation(new task_continuation([shared]
+		{
+			if (shared->m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				shared->m_complete();
+			}
+		}, nullptr));
+	}
+
+	return res;
+}
+
+template <typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures)
+{
+	struct when_any_state
+	{
+		when_any_result<T> m_result;
+		std::atomic<bool> m_fired{ false };
+		std::atomic<int> m_gate{ 2 };
+		function_wrapper m_complete;
+
+		void arrive()
+		{
+			if (m_gate.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				m_complete();
+			}
+		}
+	};
+
+	std::shared_ptr<when_any_state> shared = std::make_shared<when_any_state>();
+	when_any_state *const raw = shared.get();
+	task_scheduler *const scheduler = futures.empty() ? nullptr : futures.front().m_state->scheduler();
+	auto complete = make_pooled_task([raw] { return std::move(raw->m_result); }, scheduler);
+	task_future<when_any_result<T>> res = complete.get_future();
+	shared->m_complete = std::move(complete);
+	std::vector<task_state<T>*> states;
+	states.reserve(futures.size());
+	for (auto &future : futures)
+	{
+		states.push_back(future.m_state);
+	}
+	shared->m_result.m_index = futures.size();
+	shared->m_result.m_futures = std::move(futures);
+
+	if (states.empty())
+	{
+		shared->m_complete();
+		return res;
+	}
+
+	for (std::size_t index = 0; index < states.size(); ++index)
+	{
+		states[index]->set_continuation(new task_continuation([shared, index]
+		{
+			if (!shared->m_fired.exchange(true, std::memory_order_acq_rel))
+			{
+				shared->m_result.m_index = index;
+				shared->arrive();
+			}
+		}, nullptr));
+	}
+	shared->arrive();
+
+	return res;
+}
+
+struct worker_statistics
+{
+	std::uint64_t m_tasks_run = 0;
+	std::uint64_t m_local_tasks = 0;
+	std::uint64_t m_pool_tasks = 0;
+	std::uint64_t m_stolen_tasks = 0;
+	std::uint64_t m_steal_attempts = 0;
+	std::uint64_t m_spilled_tasks = 0;
+	std::uint64_t m_parks = 0;
+	std::uint64_t m_idle_ns = 0;
+	std::size_t m_queue_depth = 0;
+};
+
+struct pool_statistics
+{
+	std::vector<worker_statistics> m_workers;
+	worker_statistics m_external;
+	std::size_t m_pool_queue_depth = 0;
+	std::size_t m_pool_queue_high_water = 0;
+};
+
+std::ostream &write_json(std::ostream &out, const worker_statistics &stats)
+{
+	return out << "{\"tasks_run\":" << stats.m_tasks_run
+		<< ",\"local_tasks\":" << stats.m_local_tasks
+		<< ",\"pool_tasks\":" << stats.m_pool_tasks
+		<< ",\"stolen_tasks\":" << stats.m_stolen_tasks
+		<< ",\"steal_attempts\":" << stats.m_steal_attempts
+		<< ",\"spilled_tasks\":" << stats.m_spilled_tasks
+		<< ",\"parks\":" << stats.m_parks
+		<< ",\"idle_ns\":" << stats.m_idle_ns
+		<< ",\"queue_depth\":" << stats.m_queue_depth << "}";
+}
+
+std::ostream &write_json(std::ostream &out, const pool_statistics &stats)
+{
+	out << "{\"pool_queue_depth\":" << stats.m_pool_queue_depth
+		<< ",\"pool_queue_high_water\":" << stats.m_pool_queue_high_water << ",\"workers\":[";
+	for (std::size_t index = 0; index < stats.m_workers.size(); ++index)
+	{
+		if (index != 0)
+		{
+			out << ",";
+		}
+		write_json(out, stats.m_workers[index]);
+	}
+	out << "],\"external\":";
+	write_json(out, stats.m_external);
+	return out << "}";
+}
+
+enum class shutdown_mode
+{
+	drain,
+	abort
+};
+
+struct shutdown_result
+{
+	std::size_t m_tasks_run = 0;
+	std::size_t m_tasks_dropped = 0;
+	bool m_timed_out = false;
+};
+
+enum class overflow_policy
+{
+	block,
+	fail_fast,
+	caller_runs
+};
+
+enum class submit_status
+{
+	accepted,
+	rejected,
+	ran_inline
+};
+
+template <typename T>
+struct submit_result
+{
+	submit_status m_status = submit_status::accepted;
+	task_future<T> m_future;
+};
+
+class thread_pool : public task_scheduler
+{
+public:
+	thread_pool()
+		: thread_pool(0)
+	{
+
+	}
+
+	explicit thread_pool(std::size_t queue_capacity, overflow_policy policy = overflow_policy::block)
+		: m_done(false), m_draining(false), m_shutdown_drops(0), m_stopped(false),
+		m_queue_capacity(queue_capacity), m_overflow_policy(policy),
+		m_thread_count(std::thread::hardware_concurrency()), m_live_workers(m_thread_count),
+		m_counters(new worker_counters[m_thread_count + 1]), m_joiner(m_threads)
+	{
+		try
+		{
+			for (unsigned index = 0; index < m_thread_count; ++index)
+			{
+				m_threads.push_back(std::thread(&thread_pool::work_thread, this, index));
+			}
+		}
+		catch (...)
+		{
+			m_done = true;
+			throw;
+		}
+	}
+
+	~thread_pool()
+	{
+		shutdown(shutdown_mode::abort);
+	}
+
+	template <typename FunctionType>
+	task_future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
+	{
+		submit_result<typename std::result_of<FunctionType()>::type> res = try_submit(std::move(f));
+		if (res.m_status == submit_status::rejected)
 		{
-			return false;
+			throw pool_queue_full_error();
 		}
-		value = std::move(m_queue.front());
-		m_queue.pop();
-		return true;
+
+		return std::move(res.m_future);
 	}
 
-	bool empty()
+	template <typename FunctionType>
+	submit_result<typename std::result_of<FunctionType()>::type> try_submit(FunctionType f)
 	{
-		std::lock_guard<std::mutex> lk(m_mx);
-		return m_queue.empty();
-	}
+		using result_type = typename std::result_of<FunctionType()>::type;
+		if (m_done && (current_worker_index() < 0))
+		{
+			throw pool_shutdown_error();
+		}
 
-protected:
-private:
-	std::queue<T> m_queue;
-	mutable std::mutex m_mx;
-};
+		pooled_task<FunctionType> task(std::move(f), this);
+		submit_result<result_type> res;
+		res.m_future = task.get_future();
+		if (current_worker_index() >= 0)
+		{
+			push_local(std::move(task));
+		}
+		else
+		{
+			res.m_status = push_to_pool_queue(std::move(task));
+		}
 
-class function_wrapper
-{
-public:
-	function_wrapper() = default;
-	template <typename F>
-	function_wrapper(F &&f)
-		: m_impl(std::make_unique<impl_type<F>>(std::move(f)))
+		return res;
+	}
+
+	std::size_t queue_depth()
 	{
+		return m_pool_work_queue.size();
+	}
 
+	std::size_t queue_high_water_mark() const
+	{
+		return m_pool_work_queue.high_water_mark();
 	}
 
-	function_wrapper(function_wrapper &&other)
-		: m_impl(std::move(other.m_impl))
+	void schedule(function_wrapper task) override
 	{
+		const bool is_worker = (current_worker_index() >= 0);
+		if (m_done && !is_worker)
+		{
+			task();
+			return;
+		}
 
+		if (is_worker)
+		{
+			push_local(std::move(task));
+		}
+		else
+		{
+			m_pool_work_queue.push(std::move(task));
+			m_work_event.notify_one();
+		}
 	}
 
-	function_wrapper &operator=(function_wrapper &&other)
+	void run_pending_task()
 	{
-		m_impl = std::move(other.m_impl);
-		return *this;
+		if (!try_run_pending_task())
+		{
+			std::this_thread::yield();
+		}
 	}
 
-	function_wrapper(const function_wrapper&) = delete;
-	function_wrapper &operator=(const function_wrapper&) = delete;
+	shutdown_result shutdown(shutdown_mode mode, std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max())
+	{
+		std::lock_guard<std::mutex> lk(m_shutdown_mx);
+		shutdown_result result;
+		if (m_stopped)
+		{
+			return result;
+		}
 
-	void operator()()
+		const std::uint64_t tasks_run_before = tasks_run_so_far();
+		if (mode == shutdown_mode::drain)
+		{
+			m_draining = true;
+			m_work_event.notify_all();
+			result.m_timed_out = !wait_for_workers(timeout);
+		}
+
+		m_done = true;
+		m_work_event.notify_all();
+		m_space_event.notify_all();
+		for (auto &t : m_threads)
+		{
+			if (t.joinable())
+			{
+				t.join();
+			}
+		}
+		m_stopped = true;
+
+		result.m_tasks_run = static_cast<std::size_t>(tasks_run_so_far() - tasks_run_before);
+		this_thread_drop_reason = std::make_exception_ptr(pool_shutdown_error());
+		function_wrapper task;
+		while (m_pool_work_queue.try_pop(task))
+		{
+			task = function_wrapper();
+			++result.m_tasks_dropped;
+		}
+		this_thread_drop_reason = nullptr;
+		result.m_tasks_dropped += m_shutdown_drops.load();
+		return result;
+	}
+
+	pool_statistics stats()
 	{
-		m_impl->call();
+		pool_statistics stats;
+		stats.m_pool_queue_depth = m_pool_work_queue.size();
+		stats.m_pool_queue_high_water = m_pool_work_queue.high_water_mark();
+		stats.m_workers.resize(m_thread_count);
+		for (unsigned index = 0; index <= m_thread_count; ++index)
+		{
+			const worker_counters &counters = m_counters[index];
+			worker_statistics &worker = (index < m_thread_count) ? stats.m_workers[index] : stats.m_external;
+			worker.m_local_tasks = counters.m_local_tasks.load(std::memory_order_relaxed);
+			worker.m_pool_tasks = counters.m_pool_tasks.load(std::memory_order_relaxed);
+			worker.m_tasks_run = worker.m_local_tasks + worker.m_pool_tasks;
+			worker.m_parks = counters.m_parks.load(std::memory_order_relaxed);
+			worker.m_idle_ns = counters.m_idle_ns.load(std::memory_order_relaxed);
+			worker.m_spilled_tasks = counters.m_spilled_tasks.load(std::memory_order_relaxed);
+			worker.m_queue_depth = counters.m_queue_depth.load(std::memory_order_relaxed);
+		}
+		return stats;
 	}
 
 private:
-	struct impl_base
+	static const unsigned sm_spin_count = 64;
+	static const std::size_t sm_local_queue_capacity = 256;
+
+	struct worker_counters
 	{
-	public:
-		virtual ~impl_base()
-		{
+		std::atomic<std::uint64_t> m_local_tasks{ 0 };
+		std::atomic<std::uint64_t> m_pool_tasks{ 0 };
+		std::atomic<std::uint64_t> m_spilled_tasks{ 0 };
+		std::atomic<std::uint64_t> m_parks{ 0 };
+		std::atomic<std::uint64_t> m_idle_ns{ 0 };
+		std::atomic<std::uint64_t> m_queue_depth{ 0 };
+		char m_pad[64 - 6 * sizeof(std::atomic<std::uint64_t>)];
+	};
+
+	std::atomic<bool> m_done;
+	std::atomic<bool> m_draining;
+	std::atomic<std::size_t> m_shutdown_drops;
+	std::mutex m_shutdown_mx;
+	bool m_stopped;
+	injection_queue<function_wrapper> m_pool_work_queue;
+	event_count m_work_event;
+	const std::size_t m_queue_capacity;
+	const overflow_policy m_overflow_policy;
+	event_count m_space_event;
+	const unsigned m_thread_count;
+	unsigned m_live_workers;
+	std::mutex m_exit_mx;
+	std::condition_variable m_exit_cv;
+	std::unique_ptr<worker_counters[]> m_counters;
+	static thread_local std::unique_ptr<local_work_queue<function_wrapper>> sm_local_work_queue;
+	static thread_local unsigned sm_my_index;
+	static thread_local const thread_pool *sm_owner;
+	std::vector<std::thread> m_threads;
+	join_threads m_joiner;
+
+	bool try_run_pending_task()
+	{
+		function_wrapper task;
+		worker_counters &counters = my_counters();
 
+		if ((current_worker_index() >= 0)
+			&& sm_local_work_queue->try_pop(task))
+		{
+			publish_queue_depth();
+			count(counters.m_local_tasks, 1);
+		}
+		else if (m_pool_work_queue.try_pop(task))
+		{
+			if (m_queue_capacity != 0)
+			{
+				m_space_event.notify_one();
+			}
+			count(counters.m_pool_tasks, 1);
+		}
+		else
+		{
+			return false;
 		}
-		virtual void call() = 0;
-	};
 
-	std::unique_ptr<impl_base> m_impl;
+		task();
+		return true;
+	}
 
-	template <typename F>
-	struct impl_type : public impl_base
+	void work_thread(unsigned my_index)
 	{
-	public:
-		impl_type(F &&f)
-			: m_f(std::move(f))
+		task_state_allocator state_allocator;
+		this_thread_task_state_allocator = &state_allocator;
+		sm_my_index = my_index;
+		sm_local_work_queue.reset(new local_work_queue<function_wrapper>(sm_local_queue_capacity));
+		sm_owner = this;
+		bool searching = false;
+		std::chrono::steady_clock::time_point idle_mark;
+		unsigned idle_spins = 0;
+		while (!m_done)
 		{
+			if (try_run_pending_task())
+			{
+				idle_spins = 0;
+				searching = false;
+				continue;
+			}
+
+			if (m_draining)
+			{
+				break;
+			}
+
+			if (searching)
+			{
+				account_idle(idle_mark);
+			}
+			else
+			{
+				searching = true;
+				idle_mark = std::chrono::steady_clock::now();
+			}
 
+			if (++idle_spins < sm_spin_count)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				idle_spins = 0;
+				wait_for_task();
+				account_idle(idle_mark);
+			}
 		}
 
-		void call()
+		drop_local_tasks();
+		sm_owner = nullptr;
+		this_thread_task_state_allocator = nullptr;
+		worker_exited();
+	}
+
+	submit_status push_to_pool_queue(function_wrapper task)
+	{
+		if (m_queue_capacity == 0)
 		{
-			m_f();
+			m_pool_work_queue.push(std::move(task));
+			m_work_event.notify_one();
+			return submit_status::accepted;
 		}
-			
-		F m_f;
-	};
-};
 
-class thread_pool
-{
-public:
-	thread_pool()
-		: m_done(false), m_joiner(m_threads)
-	{
-		const unsigned thread_count = std::thread::hardware_concurrency();
-		try
+		while (!m_pool_work_queue.try_push(task, m_queue_capacity))
 		{
-			for (unsigned index = 0; index < thread_count; ++index)
+			if (m_overflow_policy == overflow_policy::fail_fast)
+			{
+				this_thread_drop_reason = std::make_exception_ptr(pool_queue_full_error());
+				task = function_wrapper();
+				this_thread_drop_reason = nullptr;
+				return submit_status::rejected;
+			}
+
+			if (m_overflow_policy == overflow_policy::caller_runs)
+			{
+				task();
+				return submit_status::ran_inline;
+			}
+
+			const unsigned epoch = m_space_event.prepare_wait();
+			if (m_done)
+			{
+				m_space_event.cancel_wait();
+				throw pool_shutdown_error();
+			}
+			if (m_pool_work_queue.size() < m_queue_capacity)
 			{
-				m_threads.push_back(std::thread(&thread_pool::work_thread, this));
+				m_space_event.cancel_wait();
+				continue;
 			}
+
+			m_space_event.wait(epoch);
 		}
-		catch (...)
+
+		m_work_event.notify_one();
+		return submit_status::accepted;
+	}
+
+	void push_local(function_wrapper task)
+	{
+		if (sm_local_work_queue->full())
 		{
-			m_done = true;
-			throw;
+			spill_local_tasks();
 		}
+
+		sm_local_work_queue->push(std::move(task));
+		publish_queue_depth();
 	}
 
-	~thread_pool()
+	void spill_local_tasks()
 	{
-		m_done = true;
+		std::vector<function_wrapper> batch;
+		batch.reserve(sm_local_work_queue->capacity() / 2);
+		sm_local_work_queue->take_oldest(sm_local_work_queue->capacity() / 2, batch);
+		m_pool_work_queue.push_range(batch);
+		count(my_counters().m_spilled_tasks, batch.size());
+		m_work_event.notify_all();
 	}
 
-	template <typename FunctionType>
-	std::future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
+	void drop_local_tasks()
+	{
+		this_thread_drop_reason = std::make_exception_ptr(pool_shutdown_error());
+		const std::size_t dropped = sm_local_work_queue->clear();
+		this_thread_drop_reason = nullptr;
+		m_shutdown_drops.fetch_add(dropped, std::memory_order_relaxed);
+		publish_queue_depth();
+	}
+
+	void worker_exited()
 	{
-		using result_type = typename std::result_of<FunctionType()>::type;
-		std::packaged_task<result_type()> task(std::move(f));
-		std::future<result_type> res(task.get_future());
-		if (sm_local_work_queue != nullptr)
 		{
-			sm_local_work_queue->push(std::move(task));
+			std::lock_guard<std::mutex> lk(m_exit_mx);
+			--m_live_workers;
 		}
-		else
+		m_exit_cv.notify_all();
+	}
+
+	bool wait_for_workers(std::chrono::steady_clock::duration timeout)
+	{
+		std::unique_lock<std::mutex> lk(m_exit_mx);
+		if (timeout == std::chrono::steady_clock::duration::max())
 		{
-			m_pool_work_queue.push(std::move(task));
+			m_exit_cv.wait(lk, [this] { return m_live_workers == 0; });
+			return true;
 		}
-		
-		return res;
+		return m_exit_cv.wait_for(lk, timeout, [this] { return m_live_workers == 0; });
 	}
 
-	void run_pending_task()
+	void wait_for_task()
 	{
-		function_wrapper task;
+		const unsigned epoch = m_work_event.prepare_wait();
+		if (m_done || m_draining || !m_pool_work_queue.empty())
+		{
+			m_work_event.cancel_wait();
+			return;
+		}
+
+		count(my_counters().m_parks, 1);
+		m_work_event.wait(epoch);
+	}
 
-		if ((sm_local_work_queue != nullptr)
-			&& !sm_local_work_queue->empty())
+	std::uint64_t tasks_run_so_far() const
+	{
+		std::uint64_t total = 0;
+		for (unsigned index = 0; index <= m_thread_count; ++index)
 		{
-			task = std::move(sm_local_work_queue->front());
-			sm_local_work_queue->pop();
-			task();
+			total += m_counters[index].m_local_tasks.load(std::memory_order_relaxed)
+				+ m_counters[index].m_pool_tasks.load(std::memory_order_relaxed);
 		}
-		else if (m_pool_work_queue.try_pop(task))
+		return total;
+	}
+
+	int current_worker_index() const
+	{
+		return (sm_owner == this) ? static_cast<int>(sm_my_index) : -1;
+	}
+
+	worker_counters &my_counters()
+	{
+		const int my_index = current_worker_index();
+		return m_counters[(my_index >= 0) ? static_cast<unsigned>(my_index) : m_thread_count];
+	}
+
+	void publish_queue_depth()
+	{
+		my_counters().m_queue_depth.store(sm_local_work_queue->size(), std::memory_order_relaxed);
+	}
+
+	void account_idle(std::chrono::steady_clock::time_point &idle_mark)
+	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		count(my_counters().m_idle_ns, std::chrono::duration_cast<std::chrono::nanoseconds>(now - idle_mark).count());
+		idle_mark = now;
+	}
+
+	void count(std::atomic<std::uint64_t> &counter, std::uint64_t amount)
+	{
+		if (current_worker_index() >= 0)
 		{
-			task();
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
 		}
 		else
 		{
-			std::this_thread::yield();
+			counter.fetch_add(amount, std::memory_order_relaxed);
+		}
+	}
+};
+
+thread_local std::unique_ptr<local_work_queue<function_wrapper>> thread_pool::sm_local_work_queue = nullptr;
+thread_local unsigned thread_pool::sm_my_index = 0;
+thread_local const thread_pool *thread_pool::sm_owner = nullptr;
+
+template <typename ThreadPool>
+class stats_reporter
+{
+public:
+	stats_reporter(ThreadPool &pool, std::ostream &out, std::chrono::milliseconds interval)
+		: m_pool(pool), m_out(out), m_interval(interval), m_done(false), m_thread(&stats_reporter::report, this)
+	{
+
+	}
+
+	stats_reporter(const stats_reporter&) = delete;
+	stats_reporter &operator=(const stats_reporter&) = delete;
+
+	~stats_reporter()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mx);
+			m_done = true;
 		}
+		m_cv.notify_all();
+		m_thread.join();
 	}
 
 private:
-	std::atomic<bool> m_done;
-	thread_safe_queue<function_wrapper> m_pool_work_queue;
-	static thread_local std::unique_ptr<std::queue<function_wrapper>> sm_local_work_queue;
-	std::vector<std::thread> m_threads;
-	join_threads m_joiner;
+	ThreadPool &m_pool;
+	std::ostream &m_out;
+	const std::chrono::milliseconds m_interval;
+	bool m_done;
+	std::mutex m_mx;
+	std::condition_variable m_cv;
+	std::thread m_thread;
 
-	void work_thread()
+	void report()
 	{
-		sm_local_work_queue.reset(new std::queue<function_wrapper>);
-		while (!m_done)
+		std::unique_lock<std::mutex> lk(m_mx);
+		while (!m_cv.wait_for(lk, m_interval, [this] { return m_done; }))
 		{
-			run_pending_task();
+			write_json(m_out, m_pool.stats()) << std::endl;
 		}
 	}
 };
 
-thread_local std::unique_ptr<std::queue<function_wrapper>> thread_pool::sm_local_work_queue = nullptr;
-
 template <typename T>
 struct sorter
 {
@@ -236,11 +2076,11 @@ struct sorter
 		
 		std::list<T> new_lower_chunk;
 		new_lower_chunk.splice(new_lower_chunk.end(), chunk_data, chunk_data.begin(), divide_it);
-		std::future<std::list<T>> new_lower = m_tp.submit(std::bind(&sorter::do_sort, this, std::move(new_lower_chunk)));
+		task_future<std::list<T>> new_lower = m_tp.submit(std::bind(&sorter::do_sort, this, std::move(new_lower_chunk)));
 		std::list<T> new_higher(do_sort(chunk_data));
 		result.splice(result.end(), new_higher);
 
-		while (!(new_lower.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+		while (!new_lower.is_ready())
 		{
 			m_tp.run_pending_task();
 		}
@@ -262,6 +2102,74 @@ std::list<T> parallel_quick_sort(std::list<T> input)
 	return s.do_sort(input);
 }
 
+std::size_t run_queued_tasks(thread_safe_queue<function_wrapper> &queue)
+{
+	function_wrapper task;
+	if (!queue.try_pop(task))
+	{
+		return 0;
+	}
+
+	task();
+	return 1;
+}
+
+std::size_t run_queued_tasks(injection_queue<function_wrapper> &queue)
+{
+	return queue.try_pop_batch(16, [](function_wrapper &&task) { task(); });
+}
+
+template <typename Queue>
+double injection_throughput(unsigned producers, std::size_t total_tasks)
+{
+	const unsigned consumers = 4;
+	Queue queue;
+	std::atomic<std::size_t> ran(0);
+	std::vector<std::thread> threads;
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned consumer = 0; consumer < consumers; ++consumer)
+	{
+		threads.emplace_back([&queue, &ran, total_tasks]
+		{
+			while (ran.load(std::memory_order_relaxed) < total_tasks)
+			{
+				if (run_queued_tasks(queue) == 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for (unsigned producer = 0; producer < producers; ++producer)
+	{
+		threads.emplace_back([&queue, &ran, producers, total_tasks]
+		{
+			for (std::size_t index = 0; index < total_tasks / producers; ++index)
+			{
+				queue.push(function_wrapper([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }));
+			}
+		});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(total_tasks) / elapsed.count() / 1e6;
+}
+
+void report_injection_benchmark()
+{
+	const std::size_t total_tasks = 1 << 18;
+	for (unsigned producers = 1; producers <= 64; producers *= 2)
+	{
+		std::cout << producers << " producers: mutex queue " << injection_throughput<thread_safe_queue<function_wrapper>>(producers, total_tasks)
+			<< " Mtasks/s, injection queue " << injection_throughput<injection_queue<function_wrapper>>(producers, total_tasks)
+			<< " Mtasks/s" << std::endl;
+	}
+}
+
 int main()
 {
 	std::list<int> ln{ 24, 34, 324, 23, 4, 24, 2, 4, 2, 4, 25, 3, 5, 546, 8, 67, 8, 78, 78, 980, 4, 345, 7, 79, 765, 62, 34, 2346, 0, 98, 77, 32, 34, 89, 67, 85, 45, 234, 4, 6, 8, 6, 54, 3, 7, 87, 9, 65, 45, 532, 4, 3, 4 };
@@ -271,6 +2179,64 @@ int main()
 	{
 		std::cout << data << " ";
 	}
+	std::cout << std::endl;
+
+	thread_pool tp;
+	{
+		stats_reporter<thread_pool> reporter(tp, std::cout, std::chrono::milliseconds(20));
+		std::vector<task_future<int>> results;
+		for (int index = 0; index < 100; ++index)
+		{
+			results.push_back(tp.submit([index] { std::this_thread::sleep_for(std::chrono::milliseconds(1)); return index; }));
+		}
+		for (auto &result : results)
+		{
+			result.get();
+		}
+	}
+	write_json(std::cout, tp.stats()) << std::endl;
+
+	thread_pool fan_out;
+	fan_out.submit([&fan_out]
+	{
+		std::vector<task_future<int>> children;
+		for (int index = 0; index < 10000; ++index)
+		{
+			children.push_back(fan_out.submit([index] { return index; }));
+		}
+		for (auto &child : children)
+		{
+			while (!child.is_ready())
+			{
+				fan_out.run_pending_task();
+			}
+		}
+	}).get();
+	write_json(std::cout, fan_out.stats()) << std::endl;
+
+	thread_pool bounded(16, overflow_policy::caller_runs);
+	std::size_t ran_inline = 0;
+	std::vector<task_future<int>> accepted;
+	for (int index = 0; index < 200; ++index)
+	{
+		submit_result<int> res = bounded.try_submit([index] { std::this_thread::sleep_for(std::chrono::microseconds(200)); return index; });
+		if (res.m_status == submit_status::ran_inline)
+		{
+			++ran_inline;
+		}
+		else
+		{
+			accepted.push_back(std::move(res.m_future));
+		}
+	}
+	for (auto &result : accepted)
+	{
+		result.get();
+	}
+	std::cout << "caller-runs: " << accepted.size() << " queued, " << ran_inline << " ran inline, high water "
+		<< bounded.queue_high_water_mark() << "/16" << std::endl;
+
+	report_injection_benchmark();
 
 	return 0;
 }
\ No newline at end of file
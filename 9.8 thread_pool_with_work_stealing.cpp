@@ -3,12 +3,40 @@
 #include <thread>
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 #include <future>
 #include <iostream>
 #include <list>
 #include <deque>
 #include <vector>
 #include <random>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <exception>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <cctype>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
 
 class join_threads
 {
@@ -33,106 +61,358 @@ private:
 	std::vector<std::thread> &m_threads;
 };
 
+enum class task_priority
+{
+	high,
+	normal,
+	background
+};
+
 template <typename T>
-class thread_safe_queue
+class priority_task_queue
 {
 public:
-	thread_safe_queue() = default;
-	~thread_safe_queue() = default;
+	static const std::size_t sm_lane_count = 3;
+	static const unsigned sm_aging_limit = 8;
+
+	priority_task_queue()
+		: m_passed_over()
+	{
+		for (auto &size : m_sizes)
+		{
+			size.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	~priority_task_queue() = default;
+
+	void push(task_priority priority, T data)
+	{
+		const std::size_t lane = static_cast<std::size_t>(priority);
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lk(m_mx);
+		m_lanes[lane].push(entry{ std::move(data), now });
+		m_sizes[lane].fetch_add(1, std::memory_order_release);
+		note_depth();
+	}
+
+	bool try_push(task_priority priority, T &data, std::size_t capacity)
+	{
+		const std::size_t lane = static_cast<std::size_t>(priority);
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lk(m_mx);
+		if (depth() >= capacity)
+		{
+			return false;
+		}
+
+		m_lanes[lane].push(entry{ std::move(data), now });
+		m_sizes[lane].fetch_add(1, std::memory_order_release);
+		note_depth();
+		return true;
+	}
 
-	void push(T data)
+	template <typename Iterator>
+	void push_range(task_priority priority, Iterator first, Iterator last)
 	{
+		const std::size_t lane = static_cast<std::size_t>(priority);
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 		std::lock_guard<std::mutex> lk(m_mx);
-		m_queue.push(std::move(data));
+		for (; first != last; ++first)
+		{
+			m_lanes[lane].push(entry{ std::move(*first), now });
+		}
+		m_sizes[lane].store(m_lanes[lane].size(), std::memory_order_release);
+		note_depth();
 	}
 
 	bool try_pop(T &value)
 	{
 		std::lock_guard<std::mutex> lk(m_mx);
-		if (m_queue.empty())
+		std::size_t chosen = 0;
+		while ((chosen < sm_lane_count) && m_lanes[chosen].empty())
+		{
+			++chosen;
+		}
+		if (chosen == sm_lane_count)
+		{
+			return false;
+		}
+
+		for (std::size_t lower = chosen + 1; lower < sm_lane_count; ++lower)
+		{
+			if (!m_lanes[lower].empty() && (++m_passed_over[lower] >= sm_aging_limit))
+			{
+				chosen = lower;
+				break;
+			}
+		}
+
+		m_passed_over[chosen] = 0;
+		pop_lane(chosen, value);
+		return true;
+	}
+
+	bool try_pop(task_priority priority, T &value)
+	{
+		const std::size_t lane = static_cast<std::size_t>(priority);
+		if (m_sizes[lane].load(std::memory_order_acquire) == 0)
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lk(m_mx);
+		if (m_lanes[lane].empty())
 		{
 			return false;
 		}
-		value = std::move(m_queue.front());
-		m_queue.pop();
+		pop_lane(lane, value);
+		return true;
+	}
+
+	bool empty() const
+	{
+		for (auto &size : m_sizes)
+		{
+			if (size.load(std::memory_order_acquire) != 0)
+			{
+				return false;
+			}
+		}
 		return true;
 	}
 
-	bool empty()
+	std::size_t size(task_priority priority) const
+	{
+		return m_sizes[static_cast<std::size_t>(priority)].load(std::memory_order_relaxed);
+	}
+
+	std::size_t size() const
+	{
+		std::size_t total = 0;
+		for (auto &size : m_sizes)
+		{
+			total += size.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+	std::size_t high_water_mark() const
+	{
+		return m_high_water.load(std::memory_order_relaxed);
+	}
+
+	std::chrono::steady_clock::duration oldest_wait()
 	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::duration oldest = std::chrono::steady_clock::duration::zero();
 		std::lock_guard<std::mutex> lk(m_mx);
-		return m_queue.empty();
+		for (auto &lane : m_lanes)
+		{
+			if (!lane.empty() && (now - lane.front().m_enqueued > oldest))
+			{
+				oldest = now - lane.front().m_enqueued;
+			}
+		}
+		return oldest;
 	}
 
 protected:
 private:
-	std::queue<T> m_queue;
-	mutable std::mutex m_mx;
+	struct entry
+	{
+		T m_value;
+		std::chrono::steady_clock::time_point m_enqueued;
+	};
+
+	std::queue<entry> m_lanes[sm_lane_count];
+	unsigned m_passed_over[sm_lane_count];
+	std::atomic<std::size_t> m_sizes[sm_lane_count];
+	std::atomic<std::size_t> m_high_water{ 0 };
+	std::mutex m_mx;
+
+	std::size_t depth() const
+	{
+		std::size_t total = 0;
+		for (auto &lane : m_lanes)
+		{
+			total += lane.size();
+		}
+		return total;
+	}
+
+	void note_depth()
+	{
+		const std::size_t current = depth();
+		if (current > m_high_water.load(std::memory_order_relaxed))
+		{
+			m_high_water.store(current, std::memory_order_relaxed);
+		}
+	}
+
+	void pop_lane(std::size_t lane, T &value)
+	{
+		value = std::move(m_lanes[lane].front().m_value);
+		m_lanes[lane].pop();
+		m_sizes[lane].fetch_sub(1, std::memory_order_relaxed);
+	}
 };
 
-class function_wrapper
+template <std::size_t InlineSize>
+class basic_function_wrapper
 {
 public:
-	function_wrapper() = default;
+	static_assert(InlineSize >= sizeof(void*), "inline storage must be able to hold a heap pointer");
+
 	template <typename F>
-	function_wrapper(F &&f)
-		: m_impl(std::make_unique<impl_type<F>>(std::move(f)))
+	struct is_inline
+		: std::integral_constant<bool, (sizeof(F) <= InlineSize)
+			&& (alignof(F) <= alignof(std::max_align_t))
+			&& std::is_nothrow_move_constructible<F>::value>
 	{
 
-	}
+	};
+
+	basic_function_wrapper() = default;
 
-	function_wrapper(function_wrapper &&other)
-		: m_impl(std::move(other.m_impl))
+	template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, basic_function_wrapper>::value>::type>
+	basic_function_wrapper(F &&f)
+		: m_vtable(&callable<typename std::decay<F>::type>::sm_vtable)
 	{
+		callable<typename std::decay<F>::type>::construct(&m_storage, std::forward<F>(f));
+	}
 
+	basic_function_wrapper(basic_function_wrapper &&other) noexcept
+		: m_vtable(other.m_vtable)
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->move(&other.m_storage, &m_storage);
+			other.m_vtable = nullptr;
+		}
 	}
 
-	function_wrapper &operator=(function_wrapper &&other)
+	basic_function_wrapper &operator=(basic_function_wrapper &&other) noexcept
 	{
-		m_impl = std::move(other.m_impl);
+		if (this != &other)
+		{
+			reset();
+			if (other.m_vtable != nullptr)
+			{
+				other.m_vtable->move(&other.m_storage, &m_storage);
+				m_vtable = other.m_vtable;
+				other.m_vtable = nullptr;
+			}
+		}
 		return *this;
 	}
 
-	function_wrapper(const function_wrapper&) = delete;
-	function_wrapper &operator=(const function_wrapper&) = delete;
+	~basic_function_wrapper()
+	{
+		reset();
+	}
+
+	basic_function_wrapper(const basic_function_wrapper&) = delete;
+	basic_function_wrapper &operator=(const basic_function_wrapper&) = delete;
 
 	void operator()()
 	{
-		m_impl->call();
+		m_vtable->call(&m_storage);
 	}
 
 private:
-	struct impl_base
+	struct vtable
 	{
-	public:
-		virtual ~impl_base()
+		void (*call)(void *storage);
+		void (*move)(void *from, void *to);
+		void (*destroy)(void *storage);
+	};
+
+	template <typename F, bool Inline = is_inline<F>::value>
+	struct callable
+	{
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			new (storage) F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(*static_cast<F*>(storage))();
+		}
+
+		static void move(void *from, void *to)
 		{
+			F *const f = static_cast<F*>(from);
+			new (to) F(std::move(*f));
+			f->~F();
+		}
 
+		static void destroy(void *storage)
+		{
+			static_cast<F*>(storage)->~F();
 		}
-		virtual void call() = 0;
-	};
 
-	std::unique_ptr<impl_base> m_impl;
+		static const vtable sm_vtable;
+	};
 
 	template <typename F>
-	struct impl_type : public impl_base
+	struct callable<F, false>
 	{
-	public:
-		impl_type(F &&f)
-			: m_f(std::move(f))
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			*static_cast<F**>(storage) = new F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
 		{
+			(**static_cast<F**>(storage))();
+		}
 
+		static void move(void *from, void *to)
+		{
+			*static_cast<F**>(to) = *static_cast<F**>(from);
 		}
 
-		void call()
+		static void destroy(void *storage)
 		{
-			m_f();
+			delete *static_cast<F**>(storage);
 		}
-			
-		F m_f;
+
+		static const vtable sm_vtable;
 	};
+
+	const vtable *m_vtable = nullptr;
+	typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type m_storage;
+
+	void reset()
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->destroy(&m_storage);
+			m_vtable = nullptr;
+		}
+	}
+};
+
+template <std::size_t InlineSize>
+template <typename F, bool Inline>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, Inline>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+template <std::size_t InlineSize>
+template <typename F>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, false>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
 };
 
+using function_wrapper = basic_function_wrapper<48>;
+
 class work_stealing_queue
 {
 public:
@@ -152,6 +432,12 @@ public:
 		return m_deuqe.empty();
 	}
 
+	std::size_t size() const
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		return m_deuqe.size();
+	}
+
 	bool try_pop(function_wrapper &value)
 	{
 		std::lock_guard<std::mutex> lk(m_mutex);
@@ -183,153 +469,3955 @@ private:
 	mutable std::mutex m_mutex;
 };
 
-class thread_pool
+class lock_free_work_stealing_queue
 {
 public:
-	thread_pool()
-		: m_done(false), m_joiner(m_threads)
+	explicit lock_free_work_stealing_queue(unsigned log_capacity = 5)
+		: m_top(0), m_bottom(0), m_array(new circular_array(log_capacity))
 	{
-		const unsigned thread_count = std::thread::hardware_concurrency();
-		try
+
+	}
+
+	~lock_free_work_stealing_queue()
+	{
+		circular_array *const array = m_array.load(std::memory_order_relaxed);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		for (std::int64_t index = m_top.load(std::memory_order_relaxed); index < bottom; ++index)
 		{
-			for (unsigned index = 0; index < thread_count; ++index)
-			{
-				m_queues.push_back(std::make_unique<work_stealing_queue>());
-			}
-			for (unsigned index = 0; index < thread_count; ++index)
-			{
-				m_threads.push_back(std::thread(&thread_pool::work_thread, this, index));
-			}
+			delete array->get(index);
 		}
-		catch (...)
+		delete array;
+	}
+
+	lock_free_work_stealing_queue(const lock_free_work_stealing_queue&) = delete;
+	lock_free_work_stealing_queue &operator=(const lock_free_work_stealing_queue&) = delete;
+
+	void push(function_wrapper data)
+	{
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		const std::int64_t top = m_top.load(std::memory_order_acquire);
+		circular_array *array = m_array.load(std::memory_order_relaxed);
+		if (bottom - top > array->size() - 1)
 		{
-			m_done = true;
-			throw;
+			array = grow(array, bottom, top);
 		}
+
+		array->put(bottom, new function_wrapper(std::move(data)));
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
 	}
 
-	~thread_pool()
+	bool empty() const
 	{
-		m_done = true;
+		const std::int64_t top = m_top.load(std::memory_order_acquire);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		return bottom <= top;
 	}
 
-	template <typename FunctionType>
-	std::future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
+	std::size_t size() const
 	{
-		using result_type = typename std::result_of<FunctionType()>::type;
-		std::packaged_task<result_type()> task(std::move(f));
-		std::future<result_type> res(task.get_future());
-		if (sm_local_work_queue != nullptr)
+		const std::int64_t top = m_top.load(std::memory_order_acquire);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		return bottom > top ? static_cast<std::size_t>(bottom - top) : 0;
+	}
+
+	bool try_pop(function_wrapper &value)
+	{
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		circular_array *const array = m_array.load(std::memory_order_relaxed);
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t top = m_top.load(std::memory_order_relaxed);
+		if (top > bottom)
 		{
-			sm_local_work_queue->push(std::move(task));
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
 		}
-		else
+
+		function_wrapper *const task = array->get(bottom);
+		if (top == bottom)
 		{
-			m_pool_work_queue.push(std::move(task));
+			const bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			if (!won)
+			{
+				return false;
+			}
 		}
-		
-		return res;
+
+		value = std::move(*task);
+		delete task;
+		return true;
 	}
 
-	void run_pending_task()
+	bool try_steal(function_wrapper &value)
 	{
-		function_wrapper task;
-
-		if (pop_task_from_local_queue(task)
-			|| pop_task_from_pool_queue(task)
-			|| pop_task_from_other_thread_queue(task))
+		std::int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
 		{
-			task();
+			return false;
 		}
-		else
+
+		circular_array *const array = m_array.load(std::memory_order_acquire);
+		function_wrapper *const task = array->get(top);
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
 		{
-			std::this_thread::yield();
+			return false;
 		}
+
+		value = std::move(*task);
+		delete task;
+		return true;
 	}
 
 private:
-	std::atomic<bool> m_done;
-	thread_safe_queue<function_wrapper> m_pool_work_queue;
-	std::vector<std::unique_ptr<work_stealing_queue>> m_queues;
-	std::vector<std::thread> m_threads;
-	join_threads m_joiner;
-	static thread_local work_stealing_queue* sm_local_work_queue;
-	static thread_local unsigned sm_my_index;
-
-	void work_thread(unsigned my_index)
+	class circular_array
 	{
-		sm_my_index = my_index;
-		sm_local_work_queue = m_queues[my_index].get();
-		while (!m_done)
+	public:
+		explicit circular_array(unsigned log_capacity)
+			: m_log_capacity(log_capacity), m_slots(new std::atomic<function_wrapper*>[std::size_t(1) << log_capacity])
 		{
-			run_pending_task();
+
 		}
-	}
 
-	bool pop_task_from_local_queue(function_wrapper &value)
-	{
-		return (sm_local_work_queue != nullptr) && sm_local_work_queue->try_pop(value);
-	}
+		std::int64_t size() const
+		{
+			return std::int64_t(1) << m_log_capacity;
+		}
 
-	bool pop_task_from_pool_queue(function_wrapper &value)
-	{
-		return m_pool_work_queue.try_pop(value);
-	}
+		function_wrapper *get(std::int64_t index) const
+		{
+			return m_slots[index & (size() - 1)].load(std::memory_order_acquire);
+		}
 
-	bool pop_task_from_other_thread_queue(function_wrapper &value)
-	{
-		for (unsigned index = 0; index < m_queues.size(); ++index)
+		void put(std::int64_t index, function_wrapper *task)
+		{
+			m_slots[index & (size() - 1)].store(task, std::memory_order_release);
+		}
+
+		circular_array *grow(std::int64_t bottom, std::int64_t top) const
 		{
-			const unsigned tmp = (sm_my_index + index + 1) % m_queues.size();
-			if (m_queues[tmp]->try_pop(value))
+			circular_array *const new_array = new circular_array(m_log_capacity + 1);
+			for (std::int64_t index = top; index < bottom; ++index)
 			{
-				return true;
+				new_array->put(index, get(index));
 			}
+			return new_array;
 		}
 
-		return false;
+	private:
+		const unsigned m_log_capacity;
+		std::unique_ptr<std::atomic<function_wrapper*>[]> m_slots;
+	};
+
+	std::atomic<std::int64_t> m_top;
+	char m_top_pad[64 - sizeof(std::atomic<std::int64_t>)];
+	std::atomic<std::int64_t> m_bottom;
+	char m_bottom_pad[64 - sizeof(std::atomic<std::int64_t>)];
+	std::atomic<circular_array*> m_array;
+	std::vector<std::unique_ptr<circular_array>> m_retired_arrays;
+
+	circular_array *grow(circular_array *array, std::int64_t bottom, std::int64_t top)
+	{
+		circular_array *const new_array = array->grow(bottom, top);
+		m_retired_arrays.emplace_back(array);
+		m_array.store(new_array, std::memory_order_release);
+		return new_array;
 	}
 };
 
-thread_local work_stealing_queue* thread_pool::sm_local_work_queue = nullptr;
-thread_local unsigned thread_pool::sm_my_index = 0;
-
-template <typename T>
-struct sorter
+class task_inbox
 {
-	thread_pool m_tp;
+public:
+	task_inbox()
+		: m_head(&m_stub), m_tail(&m_stub), m_size(0), m_consumer_busy(false)
+	{
 
-	std::list<T> do_sort(std::list<T> &chunk_data)
+	}
+
+	~task_inbox()
 	{
-		if (chunk_data.empty())
+		function_wrapper task;
+		while (try_pop(task))
 		{
-			return chunk_data;
+
 		}
+	}
 
-		std::list<T> result;
-		result.splice(result.begin(), chunk_data, chunk_data.begin());
-		const T &partition_val = *result.begin();
+	task_inbox(const task_inbox&) = delete;
+	task_inbox &operator=(const task_inbox&) = delete;
 
-		typename std::list<T>::iterator divide_it = std::partition(chunk_data.begin(), chunk_data.end(),
-			[&](const T &val) { return val < partition_val; });
-		
-		std::list<T> new_lower_chunk;
-		new_lower_chunk.splice(new_lower_chunk.end(), chunk_data, chunk_data.begin(), divide_it);
-		std::future<std::list<T>> new_lower = m_tp.submit(std::bind(&sorter::do_sort, this, std::move(new_lower_chunk)));
-		std::list<T> new_higher(do_sort(chunk_data));
-		result.splice(result.end(), new_higher);
+	void push(function_wrapper data)
+	{
+		m_size.fetch_add(1, std::memory_order_relaxed);
+		push_node(new node(std::move(data)));
+	}
 
-		while (!(new_lower.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+	bool try_pop(function_wrapper &value)
+	{
+		return try_pop_enqueued_before(std::chrono::steady_clock::time_point::max(), value);
+	}
+
+	bool try_pop_enqueued_before(std::chrono::steady_clock::time_point cutoff, function_wrapper &value)
+	{
+		if (empty() || m_consumer_busy.exchange(true, std::memory_order_acquire))
 		{
-			m_tp.run_pending_task();
+			return false;
 		}
 
-		result.splice(result.begin(), new_lower.get());
-		return result;
+		const bool popped = pop_front(cutoff, value);
+		m_consumer_busy.store(false, std::memory_order_release);
+		return popped;
 	}
-};
+
+	bool empty() const
+	{
+		return m_size.load(std::memory_order_relaxed) == 0;
+	}
+
+	std::size_t size() const
+	{
+		return m_size.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct node
+	{
+		node()
+			: m_next(nullptr)
+		{
+
+		}
+
+		explicit node(function_wrapper value)
+			: m_next(nullptr), m_value(std::move(value)), m_enqueued(std::chrono::steady_clock::now())
+		{
+
+		}
+
+		std::atomic<node*> m_next;
+		function_wrapper m_value;
+		std::chrono::steady_clock::time_point m_enqueued;
+	};
+
+	std::atomic<node*> m_head;
+	char m_head_pad[64 - sizeof(std::atomic<node*>)];
+	node *m_tail;
+	std::atomic<std::size_t> m_size;
+	std::atomic<bool> m_consumer_busy;
+	node m_stub;
+
+	void push_node(node *new_node)
+	{
+		new_node->m_next.store(nullptr, std::memory_order_relaxed);
+		node *const previous = m_head.exchange(new_node, std::memory_order_acq_rel);
+		previous->m_next.store(new_node, std::memory_order_release);
+	}
+
+	bool pop_front(std::chrono::steady_clock::time_point cutoff, function_wrapper &value)
+	{
+		node *tail = m_tail;
+		node *next = tail->m_next.load(std::memory_order_acquire);
+		if (tail == &m_stub)
+		{
+			if (next == nullptr)
+			{
+				return false;
+			}
+			m_tail = next;
+			tail = next;
+			next = next->m_next.load(std::memory_order_acquire);
+		}
+
+		if (!(tail->m_enqueued < cutoff))
+		{
+			return false;
+		}
+
+		if (next == nullptr)
+		{
+			if (tail != m_head.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			push_node(&m_stub);
+			next = tail->m_next.load(std::memory_order_acquire);
+			if (next == nullptr)
+			{
+				return false;
+			}
+		}
+
+		m_tail = next;
+		value = std::move(tail->m_value);
+		delete tail;
+		m_size.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+};
+
+class event_count
+{
+public:
+	event_count()
+		: m_waiters(0), m_epoch(0)
+	{
+
+	}
+
+	event_count(const event_count&) = delete;
+	event_count &operator=(const event_count&) = delete;
+
+	unsigned prepare_wait()
+	{
+		m_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_epoch.load(std::memory_order_acquire);
+	}
+
+	void cancel_wait()
+	{
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void wait(unsigned epoch)
+	{
+		{
+			std::unique_lock<std::mutex> lk(m_mutex);
+			m_cond.wait(lk, [&] { return m_epoch.load(std::memory_order_relaxed) != epoch; });
+		}
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	template <typename Rep, typename Period>
+	void wait_for(unsigned epoch, std::chrono::duration<Rep, Period> timeout)
+	{
+		{
+			std::unique_lock<std::mutex> lk(m_mutex);
+			m_cond.wait_for(lk, timeout, [&] { return m_epoch.load(std::memory_order_relaxed) != epoch; });
+		}
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void notify_one()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_one();
+	}
+
+	void notify_all()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_all();
+	}
+
+private:
+	std::atomic<unsigned> m_waiters;
+	std::atomic<unsigned> m_epoch;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	bool has_waiters() const
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_waiters.load(std::memory_order_relaxed) != 0;
+	}
+};
+
+class task_state_allocator
+{
+public:
+	task_state_allocator() = default;
+	task_state_allocator(const task_state_allocator&) = delete;
+	task_state_allocator &operator=(const task_state_allocator&) = delete;
+
+	~task_state_allocator()
+	{
+		for (std::size_t index = 0; index < sm_size_classes; ++index)
+		{
+			while (m_free_blocks[index] != nullptr)
+			{
+				free_block *const block = m_free_blocks[index];
+				m_free_blocks[index] = block->m_next;
+				::operator delete(block);
+			}
+		}
+	}
+
+	static std::size_t block_size(std::size_t size)
+	{
+		return (size + sm_block_granularity - 1) / sm_block_granularity * sm_block_granularity;
+	}
+
+	void *allocate(std::size_t size)
+	{
+		const std::size_t size_class = block_size(size) / sm_block_granularity - 1;
+		if ((size_class < sm_size_classes) && (m_free_blocks[size_class] != nullptr))
+		{
+			free_block *const block = m_free_blocks[size_class];
+			m_free_blocks[size_class] = block->m_next;
+			--m_free_counts[size_class];
+			return block;
+		}
+
+		return ::operator new(block_size(size));
+	}
+
+	void deallocate(void *memory, std::size_t size)
+	{
+		const std::size_t size_class = block_size(size) / sm_block_granularity - 1;
+		if ((size_class < sm_size_classes) && (m_free_counts[size_class] < sm_max_cached_blocks))
+		{
+			free_block *const block = static_cast<free_block*>(memory);
+			block->m_next = m_free_blocks[size_class];
+			m_free_blocks[size_class] = block;
+			++m_free_counts[size_class];
+			return;
+		}
+
+		::operator delete(memory);
+	}
+
+private:
+	static const std::size_t sm_block_granularity = 64;
+	static const std::size_t sm_size_classes = 8;
+	static const std::size_t sm_max_cached_blocks = 256;
+
+	struct free_block
+	{
+		free_block *m_next;
+	};
+
+	free_block *m_free_blocks[sm_size_classes] = {};
+	std::size_t m_free_counts[sm_size_classes] = {};
+};
+
+thread_local task_state_allocator *this_thread_task_state_allocator = nullptr;
+
+void *allocate_task_state(std::size_t size)
+{
+	if (this_thread_task_state_allocator != nullptr)
+	{
+		return this_thread_task_state_allocator->allocate(size);
+	}
+
+	return ::operator new(task_state_allocator::block_size(size));
+}
+
+void deallocate_task_state(void *memory, std::size_t size)
+{
+	if (this_thread_task_state_allocator != nullptr)
+	{
+		this_thread_task_state_allocator->deallocate(memory, size);
+	}
+	else
+	{
+		::operator delete(memory);
+	}
+}
+
+const std::size_t task_completion_stripes = 64;
+
+event_count &task_completion_event(const void *key)
+{
+	static event_count completions[task_completion_stripes];
+	return completions[(reinterpret_cast<std::uintptr_t>(key) >> 6) % task_completion_stripes];
+}
+
+event_count &any_task_completion_event()
+{
+	static event_count completion;
+	return completion;
+}
+
+void notify_task_completion(const void *key)
+{
+	task_completion_event(key).notify_all();
+	any_task_completion_event().notify_all();
+}
+
+class pool_shutdown_error : public std::runtime_error
+{
+public:
+	pool_shutdown_error()
+		: std::runtime_error("thread pool has been shut down")
+	{
+
+	}
+};
+
+class pool_queue_full_error : public std::runtime_error
+{
+public:
+	pool_queue_full_error()
+		: std::runtime_error("thread pool queue is full")
+	{
+
+	}
+};
+
+thread_local std::exception_ptr this_thread_drop_reason;
+
+class task_cancelled : public std::runtime_error
+{
+public:
+	task_cancelled()
+		: std::runtime_error("task was cancelled")
+	{
+
+	}
+};
+
+class interrupt_flag
+{
+public:
+	interrupt_flag() = default;
+	interrupt_flag(const interrupt_flag&) = delete;
+	interrupt_flag &operator=(const interrupt_flag&) = delete;
+
+	void set()
+	{
+		m_flag.store(true, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lk(m_set_clear_mutex);
+		for (std::condition_variable *cv : m_thread_conds)
+		{
+			cv->notify_all();
+		}
+	}
+
+	bool is_set() const
+	{
+		return m_flag.load(std::memory_order_relaxed);
+	}
+
+	void set_condition_variable(std::condition_variable &cv)
+	{
+		std::lock_guard<std::mutex> lk(m_set_clear_mutex);
+		m_thread_conds.push_back(&cv);
+	}
+
+	void clear_condition_variable(std::condition_variable &cv)
+	{
+		std::lock_guard<std::mutex> lk(m_set_clear_mutex);
+		m_thread_conds.erase(std::find(m_thread_conds.begin(), m_thread_conds.end(), &cv));
+	}
+
+private:
+	std::atomic<bool> m_flag{ false };
+	std::vector<std::condition_variable*> m_thread_conds;
+	std::mutex m_set_clear_mutex;
+};
+
+thread_local interrupt_flag *this_thread_interrupt_flag = nullptr;
+
+class cancellation_token
+{
+public:
+	cancellation_token() = default;
+
+	bool is_cancelled() const
+	{
+		return (m_flag != nullptr) && m_flag->is_set();
+	}
+
+	interrupt_flag *flag() const
+	{
+		return m_flag.get();
+	}
+
+private:
+	friend class cancellation_source;
+
+	std::shared_ptr<interrupt_flag> m_flag;
+
+	explicit cancellation_token(std::shared_ptr<interrupt_flag> flag)
+		: m_flag(std::move(flag))
+	{
+
+	}
+};
+
+class cancellation_source
+{
+public:
+	cancellation_source()
+		: m_flag(std::make_shared<interrupt_flag>())
+	{
+
+	}
+
+	cancellation_token token() const
+	{
+		return cancellation_token(m_flag);
+	}
+
+	void cancel()
+	{
+		m_flag->set();
+	}
+
+	bool is_cancelled() const
+	{
+		return m_flag->is_set();
+	}
+
+private:
+	std::shared_ptr<interrupt_flag> m_flag;
+};
+
+void interruption_point()
+{
+	if ((this_thread_interrupt_flag != nullptr) && this_thread_interrupt_flag->is_set())
+	{
+		throw task_cancelled();
+	}
+}
+
+template <typename Predicate>
+void interruptible_wait(std::condition_variable &cv, std::unique_lock<std::mutex> &lk, Predicate pred)
+{
+	interruption_point();
+	if (this_thread_interrupt_flag == nullptr)
+	{
+		cv.wait(lk, pred);
+		return;
+	}
+
+	interrupt_flag &flag = *this_thread_interrupt_flag;
+	flag.set_condition_variable(cv);
+	struct clear_cv_on_destruct
+	{
+		interrupt_flag &m_flag;
+		std::condition_variable &m_cv;
+
+		~clear_cv_on_destruct()
+		{
+			m_flag.clear_condition_variable(m_cv);
+		}
+	} guard{ flag, cv };
+	while (!flag.is_set() && !pred())
+	{
+		cv.wait_for(lk, std::chrono::milliseconds(1));
+	}
+	interruption_point();
+}
+
+template <typename F>
+class cancellable_task
+{
+public:
+	cancellable_task(cancellation_token token, F f)
+		: m_token(std::move(token)), m_f(std::move(f))
+	{
+
+	}
+
+	typename std::result_of<F()>::type operator()()
+	{
+		interrupt_flag *const flag = m_token.flag();
+		if ((flag != nullptr) && flag->is_set())
+		{
+			throw task_cancelled();
+		}
+
+		struct restore_flag
+		{
+			interrupt_flag *m_previous;
+
+			~restore_flag()
+			{
+				this_thread_interrupt_flag = m_previous;
+			}
+		} restore{ this_thread_interrupt_flag };
+		this_thread_interrupt_flag = flag;
+		return m_f();
+	}
+
+private:
+	cancellation_token m_token;
+	F m_f;
+};
+
+class task_scheduler
+{
+public:
+	virtual ~task_scheduler() = default;
+	virtual void schedule(function_wrapper task) = 0;
+
+	virtual bool suspend_until(bool (*)(const void*), const void*)
+	{
+		return false;
+	}
+};
+
+thread_local task_scheduler *this_thread_scheduler = nullptr;
+thread_local int this_thread_worker_index = -1;
+thread_local unsigned this_thread_help_depth = 0;
+
+class task_continuation
+{
+public:
+	task_continuation(function_wrapper task, task_scheduler *scheduler)
+		: m_task(std::move(task)), m_scheduler(scheduler)
+	{
+
+	}
+
+	void fire()
+	{
+		if (m_scheduler != nullptr)
+		{
+			m_scheduler->schedule(std::move(m_task));
+		}
+		else
+		{
+			m_task();
+		}
+		delete this;
+	}
+
+	static void fire_all(task_continuation *head)
+	{
+		task_continuation *ordered = nullptr;
+		while (head != nullptr)
+		{
+			task_continuation *const next = head->m_next;
+			head->m_next = ordered;
+			ordered = head;
+			head = next;
+		}
+
+		while (ordered != nullptr)
+		{
+			task_continuation *const next = ordered->m_next;
+			ordered->fire();
+			ordered = next;
+		}
+	}
+
+	static task_continuation *fired()
+	{
+		static task_continuation sentinel(function_wrapper(), nullptr);
+		return &sentinel;
+	}
+
+	void link(task_continuation *next)
+	{
+		m_next = next;
+	}
+
+private:
+	function_wrapper m_task;
+	task_scheduler *m_scheduler;
+	task_continuation *m_next = nullptr;
+};
+
+struct void_result
+{
+
+};
+
+template <typename T>
+class task_state
+{
+public:
+	using value_type = typename std::conditional<std::is_void<T>::value, void_result, T>::type;
+
+	static task_state *create(task_scheduler *scheduler)
+	{
+		return new (allocate_task_state(sizeof(task_state))) task_state(scheduler);
+	}
+
+	task_scheduler *scheduler() const
+	{
+		return m_scheduler;
+	}
+
+	void add_future_reference()
+	{
+		m_refs.store(2, std::memory_order_relaxed);
+	}
+
+	bool is_ready() const
+	{
+		return m_ready.load(std::memory_order_acquire);
+	}
+
+	void mark_started()
+	{
+		if ((m_scheduler != nullptr) && (m_scheduler == this_thread_scheduler))
+		{
+			m_runner.store(this_thread_worker_index, std::memory_order_relaxed);
+		}
+	}
+
+	int runner() const
+	{
+		return m_runner.load(std::memory_order_relaxed);
+	}
+
+	void wait() const
+	{
+		if (is_ready() || ((this_thread_scheduler != nullptr) && this_thread_scheduler->suspend_until(&task_state::ready, this)))
+		{
+			return;
+		}
+
+		event_count &completion = waiter_event();
+		while (!is_ready())
+		{
+			const unsigned epoch = completion.prepare_wait();
+			if (is_ready())
+			{
+				completion.cancel_wait();
+				return;
+			}
+
+			completion.wait(epoch);
+		}
+	}
+
+	template <typename... Args>
+	void set_value(Args&&... args)
+	{
+		new (&m_storage) value_type(std::forward<Args>(args)...);
+		m_has_value = true;
+		mark_ready();
+	}
+
+	void set_exception(std::exception_ptr exception)
+	{
+		m_exception = exception;
+		mark_ready();
+	}
+
+	value_type &value()
+	{
+		if (m_exception)
+		{
+			std::rethrow_exception(m_exception);
+		}
+
+		return *reinterpret_cast<value_type*>(&m_storage);
+	}
+
+	event_count &waiter_event() const
+	{
+		m_has_waiters.store(true, std::memory_order_relaxed);
+		return task_completion_event(this);
+	}
+
+	void set_continuation(task_continuation *continuation)
+	{
+		task_continuation *head = m_continuation.load(std::memory_order_acquire);
+		do
+		{
+			if (head == task_continuation::fired())
+			{
+				continuation->fire();
+				return;
+			}
+
+			continuation->link(head);
+		}
+		while (!m_continuation.compare_exchange_weak(head, continuation, std::memory_order_acq_rel, std::memory_order_acquire));
+	}
+
+	void release()
+	{
+		if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			this->~task_state();
+			deallocate_task_state(this, sizeof(task_state));
+		}
+	}
+
+private:
+	std::atomic<bool> m_ready;
+	mutable std::atomic<bool> m_has_waiters;
+	std::atomic<int> m_refs;
+	std::atomic<task_continuation*> m_continuation;
+	std::atomic<int> m_runner{ -1 };
+	task_scheduler *const m_scheduler;
+	bool m_has_value = false;
+	std::exception_ptr m_exception;
+	typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type m_storage;
+
+	explicit task_state(task_scheduler *scheduler)
+		: m_ready(false), m_has_waiters(false), m_refs(1), m_continuation(nullptr), m_scheduler(scheduler)
+	{
+
+	}
+
+	~task_state()
+	{
+		if (m_has_value)
+		{
+			reinterpret_cast<value_type*>(&m_storage)->~value_type();
+		}
+	}
+
+	static bool ready(const void *state)
+	{
+		return static_cast<const task_state*>(state)->is_ready();
+	}
+
+	void mark_ready()
+	{
+		m_ready.store(true, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_has_waiters.load(std::memory_order_relaxed))
+		{
+			task_completion_event(this).notify_all();
+		}
+		any_task_completion_event().notify_all();
+		task_continuation::fire_all(m_continuation.exchange(task_continuation::fired(), std::memory_order_acq_rel));
+	}
+};
+
+struct task_state_releaser
+{
+	template <typename State>
+	void operator()(State *state) const
+	{
+		state->release();
+	}
+};
+
+template <typename F>
+class pooled_task;
+
+template <typename F>
+pooled_task<F> make_pooled_task(F f, task_scheduler *scheduler = nullptr);
+
+template <typename T>
+class task_future;
+
+template <typename T>
+task_future<std::vector<task_future<T>>> when_all(std::vector<task_future<T>> futures);
+
+template <typename T>
+struct when_any_result
+{
+	std::size_t m_index;
+	std::vector<task_future<T>> m_futures;
+};
+
+template <typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures);
+
+template <typename WorkStealingQueue>
+class thread_pool;
+
+template <typename T>
+class task_future
+{
+public:
+	task_future() = default;
+
+	task_future(task_future &&other) noexcept
+		: m_state(other.m_state)
+	{
+		other.m_state = nullptr;
+	}
+
+	task_future &operator=(task_future &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_state = other.m_state;
+			other.m_state = nullptr;
+		}
+		return *this;
+	}
+
+	~task_future()
+	{
+		reset();
+	}
+
+	task_future(const task_future&) = delete;
+	task_future &operator=(const task_future&) = delete;
+
+	bool valid() const
+	{
+		return m_state != nullptr;
+	}
+
+	bool is_ready() const
+	{
+		return m_state->is_ready();
+	}
+
+	void wait() const
+	{
+		m_state->wait();
+	}
+
+	T get()
+	{
+		m_state->wait();
+		std::unique_ptr<task_state<T>, task_state_releaser> state(m_state);
+		m_state = nullptr;
+		return take(*state);
+	}
+
+	template <typename F>
+	task_future<typename std::result_of<F(task_future<T>)>::type> then(F fn)
+	{
+		task_state<T> *const state = m_state;
+		task_scheduler *const scheduler = state->scheduler();
+		auto task = make_pooled_task([fn = std::move(fn), future = std::move(*this)]() mutable
+		{
+			return fn(std::move(future));
+		}, scheduler);
+		auto res = task.get_future();
+		state->set_continuation(new task_continuation(std::move(task), scheduler));
+		return res;
+	}
+
+	std::future<T> to_std_future()
+	{
+		std::shared_ptr<std::promise<T>> promise = std::make_shared<std::promise<T>>();
+		std::future<T> res = promise->get_future();
+		task_state<T> *const state = m_state;
+		state->set_continuation(new task_continuation([promise, future = std::move(*this)]() mutable
+		{
+			try
+			{
+				fulfil(*promise, future);
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+			}
+		}, nullptr));
+		return res;
+	}
+
+private:
+	template <typename F>
+	friend class pooled_task;
+	template <typename WorkStealingQueue>
+	friend class thread_pool;
+	template <typename U>
+	friend task_future<std::vector<task_future<U>>> when_all(std::vector<task_future<U>> futures);
+	template <typename U>
+	friend task_future<when_any_result<U>> when_any(std::vector<task_future<U>> futures);
+
+	task_state<T> *m_state = nullptr;
+
+	explicit task_future(task_state<T> *state)
+		: m_state(state)
+	{
+
+	}
+
+	template <typename U>
+	static U take(task_state<U> &state)
+	{
+		return std::move(state.value());
+	}
+
+	static void take(task_state<void> &state)
+	{
+		state.value();
+	}
+
+	template <typename U>
+	static void fulfil(std::promise<U> &promise, task_future<U> &future)
+	{
+		promise.set_value(future.get());
+	}
+
+	static void fulfil(std::promise<void> &promise, task_future<void> &future)
+	{
+		future.get();
+		promise.set_value();
+	}
+
+	void reset()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->release();
+			m_state = nullptr;
+		}
+	}
+};
+
+template <typename F>
+class pooled_task
+{
+public:
+	using result_type = typename std::result_of<F()>::type;
+
+	explicit pooled_task(F f, task_scheduler *scheduler = nullptr)
+		: m_f(std::move(f)), m_state(task_state<result_type>::create(scheduler))
+	{
+
+	}
+
+	pooled_task(pooled_task &&other) noexcept(std::is_nothrow_move_constructible<F>::value)
+		: m_f(std::move(other.m_f)), m_state(other.m_state)
+	{
+		other.m_state = nullptr;
+	}
+
+	~pooled_task()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->set_exception((this_thread_drop_reason != nullptr) ? this_thread_drop_reason
+				: std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+			m_state->release();
+		}
+	}
+
+	pooled_task(const pooled_task&) = delete;
+	pooled_task &operator=(const pooled_task&) = delete;
+	pooled_task &operator=(pooled_task&&) = delete;
+
+	task_future<result_type> get_future()
+	{
+		m_state->add_future_reference();
+		return task_future<result_type>(m_state);
+	}
+
+	void operator()()
+	{
+		m_state->mark_started();
+		run(std::is_void<result_type>());
+		m_state->release();
+		m_state = nullptr;
+	}
+
+private:
+	F m_f;
+	task_state<result_type> *m_state;
+
+	void run(std::false_type)
+	{
+		try
+		{
+			m_state->set_value(m_f());
+		}
+		catch (...)
+		{
+			m_state->set_exception(std::current_exception());
+		}
+	}
+
+	void run(std::true_type)
+	{
+		try
+		{
+			m_f();
+			m_state->set_value();
+		}
+		catch (...)
+		{
+			m_state->set_exception(std::current_exception());
+		}
+	}
+};
+
+template <typename F>
+pooled_task<F> make_pooled_task(F f, task_scheduler *scheduler)
+{
+	return pooled_task<F>(std::move(f), scheduler);
+}
+
+template <typename T>
+task_future<std::vector<task_future<T>>> when_all(std::vector<task_future<T>> futures)
+{
+	struct when_all_state
+	{
+		std::vector<task_future<T>> m_futures;
+		std::atomic<std::size_t> m_remaining;
+		function_wrapper m_complete;
+	};
+
+	std::shared_ptr<when_all_state> shared = std::make_shared<when_all_state>();
+	when_all_state *const raw = shared.get();
+	task_scheduler *const scheduler = futures.empty() ? nullptr : futures.front().m_state->scheduler();
+	auto complete = make_pooled_task([raw] { return std::move(raw->m_futures); }, scheduler);
+	task_future<std::vector<task_future<T>>> res = complete.get_future();
+	shared->m_complete = std::move(complete);
+	shared->m_remaining.store(futures.size(), std::memory_order_relaxed);
+	std::vector<task_state<T>*> states;
+	states.reserve(futures.size());
+	for (auto &future : futures)
+	{
+		states.push_back(future.m_state);
+	}
+	shared->m_futures = std::move(futures);
+
+	if (states.empty())
+	{
+		shared->m_complete();
+		return res;
+	}
+
+	for (auto *state : states)
+	{
+		state->set_continuation(new task_continuation([shared]
+		{
+			if (shared->m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				shared->m_complete();
+			}
+		}, nullptr));
+	}
+
+	return res;
+}
+
+template <typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures)
+{
+	struct when_any_state
+	{
+		when_any_result<T> m_result;
+		std::atomic<bool> m_fired{ false };
+		std::atomic<int> m_gate{ 2 };
+		function_wrapper m_complete;
+
+		void arrive()
+		{
+			if (m_gate.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				m_complete();
+			}
+		}
+	};
+
+	std::shared_ptr<when_any_state> shared = std::make_shared<when_any_state>();
+	when_any_state *const raw = shared.get();
+	task_scheduler *const scheduler = futures.empty() ? nullptr : futures.front().m_state->scheduler();
+	auto complete = make_pooled_task([raw] { return std::move(raw->m_result); }, scheduler);
+	task_future<when_any_result<T>> res = complete.get_future();
+	shared->m_complete = std::move(complete);
+	std::vector<task_state<T>*> states;
+	states.reserve(futures.size());
+	for (auto &future : futures)
+	{
+		states.push_back(future.m_state);
+	}
+	shared->m_result.m_index = futures.size();
+	shared->m_result.m_futures = std::move(futures);
+
+	if (states.empty())
+	{
+		shared->m_complete();
+		return res;
+	}
+
+	for (std::size_t index = 0; index < states.size(); ++index)
+	{
+		states[index]->set_continuation(new task_continuation([shared, index]
+		{
+			if (!shared->m_fired.exchange(true, std::memory_order_acq_rel))
+			{
+				shared->m_result.m_index = index;
+				shared->arrive();
+			}
+		}, nullptr));
+	}
+	shared->arrive();
+
+	return res;
+}
+
+enum class victim_selection
+{
+	round_robin,
+	random
+};
+
+struct steal_policy
+{
+	victim_selection m_victims = victim_selection::random;
+	bool m_steal_half = true;
+	unsigned m_max_failed_rounds = 64;
+};
+
+struct steal_statistics
+{
+	std::uint64_t m_attempts = 0;
+	std::uint64_t m_successes = 0;
+	std::uint64_t m_tasks_stolen = 0;
+	std::uint64_t m_failed_rounds = 0;
+	std::uint64_t m_parks = 0;
+};
+
+struct worker_statistics
+{
+	std::uint64_t m_tasks_run = 0;
+	std::uint64_t m_local_tasks = 0;
+	std::uint64_t m_pool_tasks = 0;
+	std::uint64_t m_stolen_tasks = 0;
+	std::uint64_t m_steal_attempts = 0;
+	std::uint64_t m_parks = 0;
+	std::uint64_t m_idle_ns = 0;
+	std::uint64_t m_inbox_tasks = 0;
+	std::uint64_t m_max_help_depth = 0;
+	std::uint64_t m_fiber_suspends = 0;
+	std::uint64_t m_fiber_stacks = 0;
+	std::uint64_t m_stand_ins = 0;
+	std::size_t m_queue_depth = 0;
+	std::size_t m_inbox_depth = 0;
+};
+
+struct pool_statistics
+{
+	std::vector<worker_statistics> m_workers;
+	worker_statistics m_external;
+	std::size_t m_pool_queue_depth = 0;
+	std::size_t m_pool_queue_high_water = 0;
+};
+
+std::ostream &write_json(std::ostream &out, const worker_statistics &stats)
+{
+	return out << "{\"tasks_run\":" << stats.m_tasks_run
+		<< ",\"local_tasks\":" << stats.m_local_tasks
+		<< ",\"pool_tasks\":" << stats.m_pool_tasks
+		<< ",\"stolen_tasks\":" << stats.m_stolen_tasks
+		<< ",\"steal_attempts\":" << stats.m_steal_attempts
+		<< ",\"parks\":" << stats.m_parks
+		<< ",\"idle_ns\":" << stats.m_idle_ns
+		<< ",\"inbox_tasks\":" << stats.m_inbox_tasks
+		<< ",\"max_help_depth\":" << stats.m_max_help_depth
+		<< ",\"fiber_suspends\":" << stats.m_fiber_suspends
+		<< ",\"fiber_stacks\":" << stats.m_fiber_stacks
+		<< ",\"stand_ins\":" << stats.m_stand_ins
+		<< ",\"queue_depth\":" << stats.m_queue_depth
+		<< ",\"inbox_depth\":" << stats.m_inbox_depth << "}";
+}
+
+std::ostream &write_json(std::ostream &out, const pool_statistics &stats)
+{
+	out << "{\"pool_queue_depth\":" << stats.m_pool_queue_depth
+		<< ",\"pool_queue_high_water\":" << stats.m_pool_queue_high_water << ",\"workers\":[";
+	for (std::size_t index = 0; index < stats.m_workers.size(); ++index)
+	{
+		if (index != 0)
+		{
+			out << ",";
+		}
+		write_json(out, stats.m_workers[index]);
+	}
+	out << "],\"external\":";
+	write_json(out, stats.m_external);
+	return out << "}";
+}
+
+enum class overflow_policy
+{
+	block,
+	fail_fast,
+	caller_runs
+};
+
+struct thread_pool_options
+{
+	unsigned m_thread_count = 0;
+	std::vector<unsigned> m_cpus;
+	bool m_pin_threads = false;
+	bool m_numa_aware_stealing = false;
+	steal_policy m_steal_policy;
+	unsigned m_max_threads = 0;
+	std::size_t m_spawn_queue_depth = 64;
+	std::chrono::milliseconds m_spawn_wait = std::chrono::milliseconds(10);
+	std::chrono::milliseconds m_idle_retire = std::chrono::milliseconds(500);
+	std::chrono::milliseconds m_affinity_wait = std::chrono::milliseconds(1);
+	std::size_t m_queue_capacity = 0;
+	overflow_policy m_overflow_policy = overflow_policy::block;
+	unsigned m_max_help_depth = 256;
+	bool m_fiber_mode = false;
+	std::size_t m_fiber_stack_size = 256 * 1024;
+};
+
+std::vector<unsigned> parse_cpu_list(const std::string &list)
+{
+	std::vector<unsigned> cpus;
+	std::istringstream input(list);
+	std::string range;
+	while (std::getline(input, range, ','))
+	{
+		range.erase(std::remove_if(range.begin(), range.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; }), range.end());
+		if (range.empty())
+		{
+			continue;
+		}
+
+		const std::size_t dash = range.find('-');
+		std::size_t first_end = 0;
+		std::size_t last_end = 0;
+		try
+		{
+			const unsigned long first = std::stoul(range.substr(0, dash), &first_end);
+			const unsigned long last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1), &last_end);
+			if ((first_end != range.substr(0, dash).size())
+				|| ((dash != std::string::npos) && (last_end != range.size() - dash - 1))
+				|| (last < first))
+			{
+				throw std::invalid_argument(range);
+			}
+
+			for (unsigned long cpu = first; cpu <= last; ++cpu)
+			{
+				cpus.push_back(static_cast<unsigned>(cpu));
+			}
+		}
+		catch (const std::logic_error&)
+		{
+			throw std::invalid_argument("invalid cpu list: " + list);
+		}
+	}
+
+	return cpus;
+}
+
+std::vector<unsigned> allowed_cpus()
+{
+	std::vector<unsigned> cpus;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (CPU_ISSET(cpu, &set))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}
+#endif
+	for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+	{
+		cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+unsigned container_cpu_quota()
+{
+	long long quota = -1;
+	long long period = 0;
+	std::ifstream cpu_max("/sys/fs/cgroup/cpu.max");
+	std::string quota_text;
+	if (cpu_max >> quota_text >> period)
+	{
+		if (quota_text != "max")
+		{
+			quota = std::stoll(quota_text);
+		}
+	}
+	else
+	{
+		std::ifstream cfs_quota("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+		std::ifstream cfs_period("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+		if (!(cfs_quota >> quota) || !(cfs_period >> period))
+		{
+			quota = -1;
+		}
+	}
+
+	if ((quota <= 0) || (period <= 0))
+	{
+		return 0;
+	}
+
+	return static_cast<unsigned>((quota + period - 1) / period);
+}
+
+unsigned default_thread_count()
+{
+	unsigned count = static_cast<unsigned>(allowed_cpus().size());
+	const unsigned quota = container_cpu_quota();
+	if ((quota != 0) && (quota < count))
+	{
+		count = quota;
+	}
+
+	return count != 0 ? count : 1;
+}
+
+std::vector<int> cpu_numa_nodes()
+{
+	std::vector<int> nodes;
+	std::ifstream online("/sys/devices/system/node/online");
+	std::string node_list;
+	if (!std::getline(online, node_list))
+	{
+		return nodes;
+	}
+
+	for (unsigned node : parse_cpu_list(node_list))
+	{
+		std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		std::string cpu_list;
+		if (!std::getline(cpulist, cpu_list))
+		{
+			continue;
+		}
+
+		for (unsigned cpu : parse_cpu_list(cpu_list))
+		{
+			if (cpu >= nodes.size())
+			{
+				nodes.resize(cpu + 1, -1);
+			}
+			nodes[cpu] = static_cast<int>(node);
+		}
+	}
+
+	return nodes;
+}
+
+bool pin_this_thread_to_cpu(unsigned cpu)
+{
+#if defined(__linux__)
+	if (cpu >= CPU_SETSIZE)
+	{
+		return false;
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+	return (cpu < sizeof(DWORD_PTR) * 8) && (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0);
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+#if defined(__linux__)
+class fiber_stack
+{
+public:
+	explicit fiber_stack(std::size_t size)
+		: m_page_size(static_cast<std::size_t>(sysconf(_SC_PAGESIZE))),
+		m_size((size + m_page_size - 1) / m_page_size * m_page_size + m_page_size),
+		m_memory(mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0))
+	{
+		if (m_memory == MAP_FAILED)
+		{
+			throw std::bad_alloc();
+		}
+		if (mprotect(m_memory, m_page_size, PROT_NONE) != 0)
+		{
+			munmap(m_memory, m_size);
+			throw std::bad_alloc();
+		}
+	}
+
+	~fiber_stack()
+	{
+		munmap(m_memory, m_size);
+	}
+
+	fiber_stack(const fiber_stack&) = delete;
+	fiber_stack &operator=(const fiber_stack&) = delete;
+
+	void *base() const
+	{
+		return static_cast<char*>(m_memory) + m_page_size;
+	}
+
+	std::size_t size() const
+	{
+		return m_size - m_page_size;
+	}
+
+private:
+	const std::size_t m_page_size;
+	const std::size_t m_size;
+	void *const m_memory;
+};
+
+class fiber_scheduler
+{
+public:
+	explicit fiber_scheduler(std::size_t stack_size)
+		: m_stack_size(stack_size), m_current(&m_native), m_loop(nullptr), m_run_loop(nullptr)
+	{
+
+	}
+
+	fiber_scheduler(const fiber_scheduler&) = delete;
+	fiber_scheduler &operator=(const fiber_scheduler&) = delete;
+
+	static bool supported()
+	{
+		return true;
+	}
+
+	template <typename Loop>
+	void run(Loop &loop)
+	{
+		m_loop = &loop;
+		m_run_loop = [](void *loop_to_run) { (*static_cast<Loop*>(loop_to_run))(); };
+		switch_to(&m_native, acquire_fiber());
+		m_loop = nullptr;
+	}
+
+	bool on_fiber() const
+	{
+		return m_current != &m_native;
+	}
+
+	bool has_waiting() const
+	{
+		return !m_waiting.empty();
+	}
+
+	bool has_ready() const
+	{
+		for (const fiber *waiting : m_waiting)
+		{
+			if (waiting->m_ready(waiting->m_predicate))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::size_t fiber_count() const
+	{
+		return m_fibers.size();
+	}
+
+	template <typename Predicate>
+	void suspend_until(const Predicate &done)
+	{
+		fiber *const self = m_current;
+		self->m_ready = [](const void *predicate) { return static_cast<bool>((*static_cast<const Predicate*>(predicate))()); };
+		self->m_predicate = &done;
+		m_waiting.push_back(self);
+		fiber *next = take_ready_fiber();
+		switch_to(self, (next != nullptr) ? next : acquire_fiber());
+	}
+
+	bool resume_ready_fiber()
+	{
+		fiber *const ready = take_ready_fiber();
+		if (ready == nullptr)
+		{
+			return false;
+		}
+
+		fiber *const self = m_current;
+		m_free.push_back(self);
+		switch_to(self, ready);
+		return true;
+	}
+
+private:
+	static const std::size_t sm_max_cached_fibers = 64;
+
+	struct fiber
+	{
+		ucontext_t m_context;
+		std::unique_ptr<fiber_stack> m_stack;
+		bool (*m_ready)(const void*) = nullptr;
+		const void *m_predicate = nullptr;
+		interrupt_flag *m_interrupt_flag = nullptr;
+		unsigned m_help_depth = 0;
+	};
+
+	const std::size_t m_stack_size;
+	fiber m_native;
+	fiber *m_current;
+	std::vector<std::unique_ptr<fiber>> m_fibers;
+	std::vector<fiber*> m_waiting;
+	std::vector<fiber*> m_free;
+	void *m_loop;
+	void (*m_run_loop)(void*);
+
+	fiber *take_ready_fiber()
+	{
+		for (auto it = m_waiting.begin(); it != m_waiting.end(); ++it)
+		{
+			fiber *const waiting = *it;
+			if (waiting->m_ready(waiting->m_predicate))
+			{
+				m_waiting.erase(it);
+				return waiting;
+			}
+		}
+		return nullptr;
+	}
+
+	fiber *acquire_fiber()
+	{
+		if (!m_free.empty())
+		{
+			fiber *const idle = m_free.back();
+			m_free.pop_back();
+			return idle;
+		}
+
+		std::unique_ptr<fiber> created(new fiber);
+		created->m_stack.reset(new fiber_stack(m_stack_size));
+		getcontext(&created->m_context);
+		created->m_context.uc_stack.ss_sp = created->m_stack->base();
+		created->m_context.uc_stack.ss_size = created->m_stack->size();
+		created->m_context.uc_link = nullptr;
+		const std::uint64_t self = reinterpret_cast<std::uintptr_t>(this);
+		makecontext(&created->m_context, reinterpret_cast<void(*)()>(&fiber_entry), 2,
+			static_cast<unsigned>(self >> 32), static_cast<unsigned>(self & 0xffffffffu));
+		m_fibers.push_back(std::move(created));
+		return m_fibers.back().get();
+	}
+
+	void switch_to(fiber *from, fiber *to)
+	{
+		from->m_interrupt_flag = this_thread_interrupt_flag;
+		from->m_help_depth = this_thread_help_depth;
+		m_current = to;
+		swapcontext(&from->m_context, &to->m_context);
+		this_thread_interrupt_flag = from->m_interrupt_flag;
+		this_thread_help_depth = from->m_help_depth;
+		trim_free_fibers();
+	}
+
+	void trim_free_fibers()
+	{
+		while (m_free.size() > sm_max_cached_fibers)
+		{
+			fiber *const idle = m_free.back();
+			m_free.pop_back();
+			m_fibers.erase(std::find_if(m_fibers.begin(), m_fibers.end(),
+				[idle](const std::unique_ptr<fiber> &owned) { return owned.get() == idle; }));
+		}
+	}
+
+	static void fiber_entry(unsigned high, unsigned low)
+	{
+		fiber_scheduler *const scheduler = reinterpret_cast<fiber_scheduler*>(static_cast<std::uintptr_t>((static_cast<std::uint64_t>(high) << 32) | low));
+		this_thread_interrupt_flag = nullptr;
+		this_thread_help_depth = 0;
+		scheduler->m_run_loop(scheduler->m_loop);
+		scheduler->switch_to(scheduler->m_current, &scheduler->m_native);
+	}
+};
+#else
+class fiber_scheduler
+{
+public:
+	explicit fiber_scheduler(std::size_t)
+	{
+
+	}
+
+	static bool supported()
+	{
+		return false;
+	}
+
+	template <typename Loop>
+	void run(Loop &loop)
+	{
+		loop();
+	}
+
+	bool on_fiber() const
+	{
+		return false;
+	}
+
+	bool has_waiting() const
+	{
+		return false;
+	}
+
+	bool has_ready() const
+	{
+		return false;
+	}
+
+	std::size_t fiber_count() const
+	{
+		return 0;
+	}
+
+	template <typename Predicate>
+	void suspend_until(const Predicate &done)
+	{
+		while (!done())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	bool resume_ready_fiber()
+	{
+		return false;
+	}
+};
+#endif
+
+struct timer_entry
+{
+	enum state
+	{
+		pending,
+		fired,
+		cancelled
+	};
+
+	timer_entry(function_wrapper fn, std::uint64_t deadline, std::uint64_t period)
+		: m_fn(std::move(fn)), m_deadline(deadline), m_period(period), m_state(pending)
+	{
+
+	}
+
+	function_wrapper m_fn;
+	std::uint64_t m_deadline;
+	const std::uint64_t m_period;
+	std::atomic<int> m_state;
+};
+
+class timer_handle
+{
+public:
+	timer_handle() = default;
+
+	explicit timer_handle(std::shared_ptr<timer_entry> entry)
+		: m_entry(std::move(entry))
+	{
+
+	}
+
+	bool valid() const
+	{
+		return m_entry != nullptr;
+	}
+
+	bool cancel()
+	{
+		if (m_entry == nullptr)
+		{
+			return false;
+		}
+
+		int expected = timer_entry::pending;
+		if (!m_entry->m_state.compare_exchange_strong(expected, timer_entry::cancelled, std::memory_order_acq_rel))
+		{
+			return false;
+		}
+
+		if (m_entry->m_period == 0)
+		{
+			this_thread_drop_reason = std::make_exception_ptr(task_cancelled());
+			m_entry->m_fn = function_wrapper();
+			this_thread_drop_reason = nullptr;
+		}
+		return true;
+	}
+
+private:
+	std::shared_ptr<timer_entry> m_entry;
+};
+
+template <typename T>
+struct scheduled_task
+{
+	task_future<T> m_future;
+	timer_handle m_handle;
+};
+
+enum class submit_status
+{
+	accepted,
+	rejected,
+	ran_inline
+};
 
 template <typename T>
+struct submit_result
+{
+	submit_status m_status = submit_status::accepted;
+	task_future<T> m_future;
+};
+
+class timer_wheel
+{
+public:
+	static const unsigned sm_slot_bits = 6;
+	static const std::size_t sm_slot_count = std::size_t(1) << sm_slot_bits;
+	static const std::size_t sm_level_count = 4;
+
+	explicit timer_wheel(std::chrono::steady_clock::duration tick = std::chrono::milliseconds(1))
+		: m_tick(tick), m_start(std::chrono::steady_clock::now()), m_current(0), m_size(0)
+	{
+
+	}
+
+	std::uint64_t deadline_tick(std::chrono::steady_clock::time_point when) const
+	{
+		if (when <= m_start)
+		{
+			return 0;
+		}
+		return static_cast<std::uint64_t>((when - m_start + m_tick - std::chrono::steady_clock::duration(1)) / m_tick);
+	}
+
+	std::uint64_t period_ticks(std::chrono::steady_clock::duration period) const
+	{
+		return std::max<std::uint64_t>(1, static_cast<std::uint64_t>((period + m_tick - std::chrono::steady_clock::duration(1)) / m_tick));
+	}
+
+	std::uint64_t now_tick() const
+	{
+		return static_cast<std::uint64_t>((std::chrono::steady_clock::now() - m_start) / m_tick);
+	}
+
+	std::chrono::steady_clock::time_point tick_time(std::uint64_t tick) const
+	{
+		return m_start + m_tick * static_cast<std::chrono::steady_clock::rep>(tick);
+	}
+
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	void insert(std::shared_ptr<timer_entry> entry)
+	{
+		++m_size;
+		place(std::move(entry));
+	}
+
+	void advance(std::uint64_t now, std::vector<std::shared_ptr<timer_entry>> &expired)
+	{
+		if (m_size == 0)
+		{
+			m_current = std::max(m_current, now);
+			return;
+		}
+
+		while (m_current < now)
+		{
+			++m_current;
+			for (std::size_t level = sm_level_count - 1; level > 0; --level)
+			{
+				if ((m_current & ((std::uint64_t(1) << (sm_slot_bits * level)) - 1)) == 0)
+				{
+					cascade(level, (m_current >> (sm_slot_bits * level)) & (sm_slot_count - 1));
+				}
+			}
+
+			std::vector<std::shared_ptr<timer_entry>> &slot = m_slots[0][m_current & (sm_slot_count - 1)];
+			m_size -= slot.size();
+			for (auto &entry : slot)
+			{
+				if (entry->m_state.load(std::memory_order_acquire) == timer_entry::pending)
+				{
+					expired.push_back(std::move(entry));
+				}
+			}
+			slot.clear();
+		}
+	}
+
+	void clear(std::vector<std::shared_ptr<timer_entry>> &entries)
+	{
+		for (auto &level : m_slots)
+		{
+			for (auto &slot : level)
+			{
+				for (auto &entry : slot)
+				{
+					entries.push_back(std::move(entry));
+				}
+				slot.clear();
+			}
+		}
+		m_size = 0;
+	}
+
+	std::uint64_t next_expiry() const
+	{
+		for (std::uint64_t tick = m_current + 1; tick <= m_current + sm_slot_count; ++tick)
+		{
+			if (!m_slots[0][tick & (sm_slot_count - 1)].empty())
+			{
+				return tick;
+			}
+		}
+		return ((m_current >> sm_slot_bits) + 1) << sm_slot_bits;
+	}
+
+private:
+	const std::chrono::steady_clock::duration m_tick;
+	const std::chrono::steady_clock::time_point m_start;
+	std::uint64_t m_current;
+	std::size_t m_size;
+	std::vector<std::shared_ptr<timer_entry>> m_slots[sm_level_count][sm_slot_count];
+
+	void place(std::shared_ptr<timer_entry> entry)
+	{
+		const std::uint64_t deadline = std::max(entry->m_deadline, m_current + 1);
+		const std::uint64_t delta = deadline - m_current;
+		std::size_t level = 0;
+		while ((level + 1 < sm_level_count) && (delta >= (std::uint64_t(1) << (sm_slot_bits * (level + 1)))))
+		{
+			++level;
+		}
+
+		m_slots[level][(deadline >> (sm_slot_bits * level)) & (sm_slot_count - 1)].push_back(std::move(entry));
+	}
+
+	void cascade(std::size_t level, std::uint64_t index)
+	{
+		std::vector<std::shared_ptr<timer_entry>> entries;
+		entries.swap(m_slots[level][index]);
+		for (auto &entry : entries)
+		{
+			if (entry->m_state.load(std::memory_order_acquire) == timer_entry::pending)
+			{
+				place(std::move(entry));
+			}
+			else
+			{
+				--m_size;
+			}
+		}
+	}
+};
+
+enum class shutdown_mode
+{
+	drain,
+	abort
+};
+
+struct shutdown_result
+{
+	std::size_t m_tasks_run = 0;
+	std::size_t m_tasks_dropped = 0;
+	bool m_timed_out = false;
+};
+
+enum class task_affinity
+{
+	pinned,
+	preferred
+};
+
+template <typename ThreadPool>
+class task_group;
+
+template <typename WorkStealingQueue = lock_free_work_stealing_queue>
+class thread_pool : public task_scheduler
+{
+public:
+	thread_pool()
+		: thread_pool(thread_pool_options())
+	{
+
+	}
+
+	explicit thread_pool(steal_policy policy)
+		: thread_pool(options_with_policy(policy))
+	{
+
+	}
+
+	explicit thread_pool(thread_pool_options options)
+		: m_done(false), m_policy(options.m_steal_policy), m_active_threads(0), m_elastic(options.m_max_threads != 0),
+		m_spawn_queue_depth(options.m_spawn_queue_depth), m_spawn_wait(options.m_spawn_wait), m_idle_retire(options.m_idle_retire),
+		m_affinity_wait(options.m_affinity_wait), m_queue_capacity(options.m_queue_capacity), m_overflow_policy(options.m_overflow_policy),
+		m_max_help_depth(options.m_max_help_depth), m_fiber_mode(options.m_fiber_mode && fiber_scheduler::supported()),
+		m_fiber_stack_size(options.m_fiber_stack_size), m_joiner(m_threads)
+	{
+		if (options.m_pin_threads && options.m_cpus.empty())
+		{
+			options.m_cpus = allowed_cpus();
+		}
+		const unsigned thread_count = (options.m_thread_count != 0) ? options.m_thread_count
+			: !options.m_cpus.empty() ? static_cast<unsigned>(options.m_cpus.size())
+			: default_thread_count();
+		const unsigned slot_count = std::max(thread_count, options.m_max_threads);
+		m_worker_cpus.assign(slot_count, -1);
+		if (options.m_pin_threads)
+		{
+			for (unsigned index = 0; index < slot_count; ++index)
+			{
+				m_worker_cpus[index] = static_cast<int>(options.m_cpus[index % options.m_cpus.size()]);
+			}
+		}
+		if (options.m_numa_aware_stealing)
+		{
+			build_victim_order(m_worker_cpus);
+		}
+
+		try
+		{
+			m_counters.reset(new worker_counters[slot_count + 1]);
+			m_slots.reset(new worker_slot[slot_count]);
+			m_inboxes.reset(new worker_inbox[slot_count]);
+			for (unsigned index = 0; index < slot_count; ++index)
+			{
+				m_queues.push_back(std::make_unique<WorkStealingQueue>());
+			}
+			m_threads.resize(slot_count);
+			for (unsigned index = 0; index < thread_count; ++index)
+			{
+				start_worker(index);
+			}
+			m_min_threads = thread_count;
+			if (m_elastic)
+			{
+				m_supervisor = std::thread(&thread_pool::supervise, this);
+			}
+		}
+		catch (...)
+		{
+			m_done = true;
+			m_work_event.notify_all();
+			throw;
+		}
+	}
+
+	~thread_pool()
+	{
+		shutdown(shutdown_mode::abort);
+	}
+
+	shutdown_result shutdown(shutdown_mode mode, std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max())
+	{
+		std::lock_guard<std::mutex> lk(m_shutdown_mx);
+		shutdown_result result;
+		if (m_stopped)
+		{
+			return result;
+		}
+
+		const std::uint64_t tasks_run_before = tasks_run_so_far();
+		if (mode == shutdown_mode::drain)
+		{
+			m_draining = true;
+			m_work_event.notify_all();
+			result.m_timed_out = !wait_for_workers(timeout);
+		}
+
+		m_done = true;
+		m_work_event.notify_all();
+		m_space_event.notify_all();
+		if (m_supervisor.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> supervisor_lk(m_supervisor_mx);
+			}
+			m_supervisor_cv.notify_all();
+			m_supervisor.join();
+		}
+		if (m_timer_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> timer_lk(m_timer_mx);
+			}
+			m_timer_cv.notify_all();
+			m_timer_thread.join();
+		}
+		for (auto &t : m_threads)
+		{
+			if (t.joinable())
+			{
+				t.join();
+			}
+		}
+		m_stopped = true;
+
+		result.m_tasks_run = static_cast<std::size_t>(tasks_run_so_far() - tasks_run_before);
+		result.m_tasks_dropped = drop_pending_tasks();
+		return result;
+	}
+
+	template <typename FunctionType>
+	task_future<typename std::result_of<FunctionType()>::type> submit(FunctionType f)
+	{
+		return submit(task_priority::normal, std::move(f));
+	}
+
+	template <typename FunctionType>
+	task_future<typename std::result_of<FunctionType()>::type> submit(task_priority priority, FunctionType f)
+	{
+		submit_result<typename std::result_of<FunctionType()>::type> res = try_submit(priority, std::move(f));
+		if (res.m_status == submit_status::rejected)
+		{
+			throw pool_queue_full_error();
+		}
+
+		return std::move(res.m_future);
+	}
+
+	template <typename FunctionType>
+	submit_result<typename std::result_of<FunctionType()>::type> try_submit(FunctionType f)
+	{
+		return try_submit(task_priority::normal, std::move(f));
+	}
+
+	template <typename FunctionType>
+	submit_result<typename std::result_of<FunctionType()>::type> try_submit(task_priority priority, FunctionType f)
+	{
+		using result_type = typename std::result_of<FunctionType()>::type;
+		if (m_done && (current_worker_index() < 0))
+		{
+			throw pool_shutdown_error();
+		}
+
+		pooled_task<FunctionType> task(std::move(f), this);
+		submit_result<result_type> res;
+		res.m_future = task.get_future();
+		if ((priority == task_priority::normal) && (current_worker_index() >= 0))
+		{
+			sm_local_work_queue->push(std::move(task));
+			m_work_event.notify_one();
+		}
+		else
+		{
+			res.m_status = push_to_pool_queue(priority, std::move(task));
+		}
+
+		return res;
+	}
+
+	std::size_t queue_depth() const
+	{
+		return m_pool_work_queue.size();
+	}
+
+	std::size_t queue_high_water_mark() const
+	{
+		return m_pool_work_queue.high_water_mark();
+	}
+
+	template <typename FunctionType>
+	task_future<typename std::result_of<FunctionType()>::type> submit(const cancellation_token &token, FunctionType f)
+	{
+		return submit(task_priority::normal, cancellable_task<FunctionType>(token, std::move(f)));
+	}
+
+	template <typename FunctionType>
+	task_future<typename std::result_of<FunctionType()>::type> submit_to(std::size_t worker_index, FunctionType f, task_affinity affinity = task_affinity::pinned)
+	{
+		using result_type = typename std::result_of<FunctionType()>::type;
+		if (worker_index >= m_queues.size())
+		{
+			throw std::out_of_range("thread_pool::submit_to: no such worker");
+		}
+		if (m_done && (current_worker_index() < 0))
+		{
+			throw pool_shutdown_error();
+		}
+
+		pooled_task<FunctionType> task(std::move(f), this);
+		task_future<result_type> res(task.get_future());
+		worker_inbox &inbox = m_inboxes[worker_index];
+		((affinity == task_affinity::pinned) ? inbox.m_pinned : inbox.m_preferred).push(std::move(task));
+		m_work_event.notify_all();
+
+		return res;
+	}
+
+	template <typename FunctionType>
+	task_future<typename std::result_of<FunctionType()>::type> submit_local(FunctionType f)
+	{
+		const int worker_index = current_worker_index();
+		if (worker_index < 0)
+		{
+			return submit(std::move(f));
+		}
+
+		return submit_to(static_cast<std::size_t>(worker_index), std::move(f));
+	}
+
+	int current_worker_index() const
+	{
+		if ((sm_local_work_queue == nullptr) || (sm_my_index >= m_queues.size()) || (m_queues[sm_my_index].get() != sm_local_work_queue))
+		{
+			return -1;
+		}
+
+		return static_cast<int>(sm_my_index);
+	}
+
+	template <typename Iterator>
+	std::vector<task_future<typename std::result_of<typename std::iterator_traits<Iterator>::value_type()>::type>> submit_batch(Iterator first, Iterator last)
+	{
+		using result_type = typename std::result_of<typename std::iterator_traits<Iterator>::value_type()>::type;
+		std::vector<function_wrapper> tasks;
+		std::vector<task_future<result_type>> res;
+		for (; first != last; ++first)
+		{
+			auto task = make_pooled_task(std::move(*first), this);
+			res.push_back(task.get_future());
+			tasks.push_back(std::move(task));
+		}
+
+		push_batch(tasks);
+		return res;
+	}
+
+	template <typename FunctionType>
+	std::vector<task_future<typename std::result_of<FunctionType(std::size_t)>::type>> submit_n(std::size_t count, FunctionType index_fn)
+	{
+		using result_type = typename std::result_of<FunctionType(std::size_t)>::type;
+		std::vector<function_wrapper> tasks;
+		std::vector<task_future<result_type>> res;
+		tasks.reserve(count);
+		res.reserve(count);
+		for (std::size_t index = 0; index < count; ++index)
+		{
+			auto task = make_pooled_task(std::bind(index_fn, index), this);
+			res.push_back(task.get_future());
+			tasks.push_back(std::move(task));
+		}
+
+		push_batch(tasks);
+		return res;
+	}
+
+	void schedule(function_wrapper task) override
+	{
+		const bool is_worker = (current_worker_index() >= 0);
+		if (m_done && !is_worker)
+		{
+			task();
+			return;
+		}
+
+		if (is_worker)
+		{
+			sm_local_work_queue->push(std::move(task));
+		}
+		else
+		{
+			m_pool_work_queue.push(task_priority::normal, std::move(task));
+		}
+		m_work_event.notify_one();
+	}
+
+	bool suspend_until(bool (*ready)(const void*), const void *context) override
+	{
+		if ((sm_fibers == nullptr) || !sm_fibers->on_fiber() || (current_worker_index() < 0))
+		{
+			return false;
+		}
+
+		help_until([ready, context] { return ready(context); });
+		return true;
+	}
+
+	template <typename FunctionType>
+	scheduled_task<typename std::result_of<FunctionType()>::type> submit_at(std::chrono::steady_clock::time_point when, FunctionType f)
+	{
+		using result_type = typename std::result_of<FunctionType()>::type;
+		pooled_task<FunctionType> task(std::move(f), this);
+		scheduled_task<result_type> res;
+		res.m_future = task.get_future();
+		res.m_handle = add_timer(when, std::chrono::steady_clock::duration::zero(), std::move(task));
+		return res;
+	}
+
+	template <typename Rep, typename Period, typename FunctionType>
+	scheduled_task<typename std::result_of<FunctionType()>::type> submit_after(std::chrono::duration<Rep, Period> delay, FunctionType f)
+	{
+		return submit_at(std::chrono::steady_clock::now() + delay, std::move(f));
+	}
+
+	template <typename Rep, typename Period, typename FunctionType>
+	timer_handle submit_every(std::chrono::duration<Rep, Period> period, FunctionType f)
+	{
+		const std::chrono::steady_clock::duration interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+		return add_timer(std::chrono::steady_clock::now() + interval, interval, std::move(f));
+	}
+
+	void run_pending_task()
+	{
+		if (!try_run_pending_task())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	template <typename Predicate>
+	void help_until(Predicate done)
+	{
+		help_until(done, [] { return sm_any_runner; }, any_task_completion_event());
+	}
+
+	template <typename Predicate>
+	void help_until(Predicate done, event_count &completion)
+	{
+		help_until(done, [] { return sm_any_runner; }, completion);
+	}
+
+	template <typename Predicate, typename Runner>
+	void help_until(Predicate done, Runner runner, event_count &completion)
+	{
+		if ((sm_fibers != nullptr) && sm_fibers->on_fiber() && (current_worker_index() >= 0))
+		{
+			help_depth_scope depth(*this);
+			function_wrapper task;
+			while (!done() && !depth.capped() && (runner() == sm_unstarted_runner) && pop_task_from_local_queue(task))
+			{
+				count(my_counters().m_local_tasks, 1);
+				task();
+			}
+			suspend_fiber_until(done);
+			return;
+		}
+
+		help_depth_scope depth(*this);
+		if (depth.capped())
+		{
+			wait_past_help_cap(done, completion);
+			return;
+		}
+
+		const bool targeted = (&completion != &any_task_completion_event());
+		unsigned failed_rounds = 0;
+		while (!done())
+		{
+			const int waiting_on = runner();
+			if (try_run_dependent_task(waiting_on))
+			{
+				failed_rounds = 0;
+			}
+			else if (++failed_rounds < m_policy.m_max_failed_rounds)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				failed_rounds = 0;
+				const unsigned epoch = completion.prepare_wait();
+				if (done() || ((waiting_on == sm_any_runner) && has_pending_task()))
+				{
+					completion.cancel_wait();
+					continue;
+				}
+
+				if ((waiting_on == sm_any_runner) && (!targeted || (current_worker_index() < 0)))
+				{
+					completion.wait(epoch);
+				}
+				else
+				{
+					completion.wait_for(epoch, m_affinity_wait);
+					if (!done() && (waiting_on < 0) && (current_worker_index() >= 0))
+					{
+						try_run_pending_task();
+					}
+				}
+			}
+		}
+	}
+
+	template <typename T>
+	void wait(task_future<T> &future)
+	{
+		task_state<T> *const state = future.m_state;
+		help_until([state] { return state->is_ready(); }, [state] { return state->runner(); }, state->waiter_event());
+	}
+
+	template <typename Function, typename... Functions>
+	void parallel_invoke(Function &&first, Functions&&... rest)
+	{
+		task_group<thread_pool> group(*this);
+		int spawned[] = { 0, (group.run(std::forward<Functions>(rest)), 0)... };
+		(void)spawned;
+		first();
+		group.wait();
+	}
+
+	const steal_policy &policy() const
+	{
+		return m_policy;
+	}
+
+	std::size_t thread_count() const
+	{
+		return m_active_threads.load(std::memory_order_relaxed);
+	}
+
+	steal_statistics steal_stats() const
+	{
+		steal_statistics stats;
+		for (std::size_t index = 0; index <= m_queues.size(); ++index)
+		{
+			const worker_counters &counters = m_counters[index];
+			stats.m_attempts += counters.m_attempts.load(std::memory_order_relaxed);
+			stats.m_successes += counters.m_successes.load(std::memory_order_relaxed);
+			stats.m_tasks_stolen += counters.m_tasks_stolen.load(std::memory_order_relaxed);
+			stats.m_failed_rounds += counters.m_failed_rounds.load(std::memory_order_relaxed);
+			stats.m_parks += counters.m_parks.load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+
+	pool_statistics stats() const
+	{
+		pool_statistics stats;
+		stats.m_pool_queue_depth = m_pool_work_queue.size();
+		stats.m_pool_queue_high_water = m_pool_work_queue.high_water_mark();
+		stats.m_workers.resize(m_queues.size());
+		for (std::size_t index = 0; index <= m_queues.size(); ++index)
+		{
+			const worker_counters &counters = m_counters[index];
+			worker_statistics &worker = (index < m_queues.size()) ? stats.m_workers[index] : stats.m_external;
+			worker.m_local_tasks = counters.m_local_tasks.load(std::memory_order_relaxed);
+			worker.m_pool_tasks = counters.m_pool_tasks.load(std::memory_order_relaxed);
+			worker.m_stolen_tasks = counters.m_successes.load(std::memory_order_relaxed);
+			worker.m_inbox_tasks = counters.m_inbox_tasks.load(std::memory_order_relaxed);
+			worker.m_tasks_run = worker.m_local_tasks + worker.m_pool_tasks + worker.m_stolen_tasks + worker.m_inbox_tasks;
+			worker.m_steal_attempts = counters.m_attempts.load(std::memory_order_relaxed);
+			worker.m_parks = counters.m_parks.load(std::memory_order_relaxed);
+			worker.m_idle_ns = counters.m_idle_ns.load(std::memory_order_relaxed);
+			worker.m_max_help_depth = counters.m_max_help_depth.load(std::memory_order_relaxed);
+			worker.m_fiber_suspends = counters.m_fiber_suspends.load(std::memory_order_relaxed);
+			worker.m_fiber_stacks = counters.m_fiber_stacks.load(std::memory_order_relaxed);
+			worker.m_stand_ins = counters.m_stand_ins.load(std::memory_order_relaxed);
+			if (index < m_queues.size())
+			{
+				worker.m_queue_depth = m_queues[index]->size();
+				worker.m_inbox_depth = m_inboxes[index].m_pinned.size() + m_inboxes[index].m_preferred.size();
+			}
+		}
+		return stats;
+	}
+
+private:
+	struct worker_counters
+	{
+		std::atomic<std::uint64_t> m_local_tasks{ 0 };
+		std::atomic<std::uint64_t> m_pool_tasks{ 0 };
+		std::atomic<std::uint64_t> m_attempts{ 0 };
+		std::atomic<std::uint64_t> m_successes{ 0 };
+		std::atomic<std::uint64_t> m_tasks_stolen{ 0 };
+		std::atomic<std::uint64_t> m_failed_rounds{ 0 };
+		std::atomic<std::uint64_t> m_parks{ 0 };
+		std::atomic<std::uint64_t> m_idle_ns{ 0 };
+		std::atomic<std::uint64_t> m_inbox_tasks{ 0 };
+		std::atomic<std::uint64_t> m_max_help_depth{ 0 };
+		std::atomic<std::uint64_t> m_fiber_suspends{ 0 };
+		std::atomic<std::uint64_t> m_fiber_stacks{ 0 };
+		std::atomic<std::uint64_t> m_stand_ins{ 0 };
+		char m_pad[128 - 13 * sizeof(std::atomic<std::uint64_t>)];
+	};
+
+	class help_depth_scope
+	{
+	public:
+		explicit help_depth_scope(thread_pool &pool)
+			: m_capped((pool.m_max_help_depth != 0) && (this_thread_help_depth >= pool.m_max_help_depth))
+		{
+			if (!m_capped)
+			{
+				std::atomic<std::uint64_t> &max_depth = pool.my_counters().m_max_help_depth;
+				if (++this_thread_help_depth > max_depth.load(std::memory_order_relaxed))
+				{
+					max_depth.store(this_thread_help_depth, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		~help_depth_scope()
+		{
+			if (!m_capped)
+			{
+				--this_thread_help_depth;
+			}
+		}
+
+		help_depth_scope(const help_depth_scope&) = delete;
+		help_depth_scope &operator=(const help_depth_scope&) = delete;
+
+		bool capped() const
+		{
+			return m_capped;
+		}
+
+	private:
+		const bool m_capped;
+	};
+
+	static const int sm_unstarted_runner = -1;
+	static const int sm_any_runner = -2;
+
+	struct worker_inbox
+	{
+		task_inbox m_pinned;
+		task_inbox m_preferred;
+	};
+
+	enum class worker_state
+	{
+		vacant,
+		running,
+		retiring
+	};
+
+	struct worker_slot
+	{
+		std::atomic<worker_state> m_state{ worker_state::vacant };
+		std::atomic<std::chrono::steady_clock::rep> m_idle_since{ 0 };
+		char m_pad[64 - 2 * sizeof(std::atomic<std::chrono::steady_clock::rep>)];
+	};
+
+	std::atomic<bool> m_done;
+	std::atomic<bool> m_draining{ false };
+	std::mutex m_shutdown_mx;
+	bool m_stopped = false;
+	unsigned m_live_workers = 0;
+	std::mutex m_exit_mx;
+	std::condition_variable m_exit_cv;
+	const steal_policy m_policy;
+	priority_task_queue<function_wrapper> m_pool_work_queue;
+	event_count m_work_event;
+	std::vector<std::unique_ptr<WorkStealingQueue>> m_queues;
+	std::unique_ptr<worker_counters[]> m_counters;
+	std::unique_ptr<worker_slot[]> m_slots;
+	std::unique_ptr<worker_inbox[]> m_inboxes;
+	std::vector<int> m_worker_cpus;
+	std::vector<std::vector<unsigned>> m_victim_order;
+	std::vector<std::size_t> m_near_victim_count;
+	std::atomic<unsigned> m_active_threads;
+	unsigned m_min_threads = 0;
+	const bool m_elastic;
+	const std::size_t m_spawn_queue_depth;
+	const std::chrono::milliseconds m_spawn_wait;
+	const std::chrono::milliseconds m_idle_retire;
+	const std::chrono::milliseconds m_affinity_wait;
+	const std::size_t m_queue_capacity;
+	const overflow_policy m_overflow_policy;
+	event_count m_space_event;
+	const unsigned m_max_help_depth;
+	const bool m_fiber_mode;
+	const std::size_t m_fiber_stack_size;
+	std::mutex m_supervisor_mx;
+	std::condition_variable m_supervisor_cv;
+	std::thread m_supervisor;
+	std::mutex m_timer_mx;
+	std::condition_variable m_timer_cv;
+	timer_wheel m_timers;
+	std::atomic<bool> m_timers_due{ false };
+	std::once_flag m_timer_thread_started;
+	std::thread m_timer_thread;
+	std::vector<std::thread> m_threads;
+	join_threads m_joiner;
+	static thread_local WorkStealingQueue* sm_local_work_queue;
+	static thread_local unsigned sm_my_index;
+	static thread_local std::minstd_rand sm_victim_random;
+	static thread_local unsigned sm_local_streak;
+	static thread_local fiber_scheduler *sm_fibers;
+
+	bool try_run_pending_task()
+	{
+		function_wrapper task;
+		worker_counters &counters = my_counters();
+		if (m_timers_due.load(std::memory_order_relaxed) && (current_worker_index() >= 0))
+		{
+			service_timers();
+		}
+
+		if (pop_task_from_pool_queue(task, task_priority::high))
+		{
+			count(counters.m_pool_tasks, 1);
+		}
+		else if (pop_task_from_local_queue(task))
+		{
+			count(counters.m_local_tasks, 1);
+		}
+		else if (pop_task_from_inbox(task))
+		{
+			count(counters.m_inbox_tasks, 1);
+		}
+		else if (pop_task_from_pool_queue(task))
+		{
+			count(counters.m_pool_tasks, 1);
+		}
+		else if (!pop_task_from_other_thread_queue(task) && !steal_overdue_preferred_task(task))
+		{
+			return false;
+		}
+
+		mark_busy();
+		task();
+		return true;
+	}
+
+	void mark_busy()
+	{
+		const int my_index = current_worker_index();
+		if (my_index >= 0)
+		{
+			std::atomic<std::chrono::steady_clock::rep> &idle_since = m_slots[my_index].m_idle_since;
+			if (idle_since.load(std::memory_order_relaxed) != 0)
+			{
+				idle_since.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	template <typename Predicate>
+	void wait_past_help_cap(Predicate &done, event_count &completion)
+	{
+		while (!done())
+		{
+			function_wrapper task;
+			const bool own_task = pop_task_from_local_queue(task);
+			if (own_task || has_pending_task())
+			{
+				bool ran = own_task;
+				count(my_counters().m_stand_ins, 1);
+				std::thread stand_in([this, &task, &ran]
+				{
+					if (ran)
+					{
+						task();
+					}
+					else
+					{
+						ran = try_run_pending_task();
+					}
+				});
+				stand_in.join();
+				if (ran)
+				{
+					continue;
+				}
+			}
+
+			const unsigned epoch = completion.prepare_wait();
+			if (done())
+			{
+				completion.cancel_wait();
+				break;
+			}
+
+			completion.wait_for(epoch, m_affinity_wait);
+		}
+	}
+
+	bool try_run_dependent_task(int runner)
+	{
+		const int my_index = current_worker_index();
+		function_wrapper task;
+		if ((runner >= 0) && (runner != my_index))
+		{
+			if ((static_cast<std::size_t>(runner) >= m_queues.size()) || !try_leapfrog(static_cast<std::size_t>(runner), task))
+			{
+				return false;
+			}
+		}
+		else if ((runner == sm_any_runner) || (my_index < 0))
+		{
+			return try_run_pending_task();
+		}
+		else if (pop_task_from_local_queue(task))
+		{
+			count(my_counters().m_local_tasks, 1);
+		}
+		else
+		{
+			return false;
+		}
+
+		task();
+		return true;
+	}
+
+	static thread_pool_options options_with_policy(steal_policy policy)
+	{
+		thread_pool_options options;
+		options.m_steal_policy = policy;
+		return options;
+	}
+
+	void build_victim_order(const std::vector<int> &worker_cpus)
+	{
+		const std::vector<int> cpu_nodes = cpu_numa_nodes();
+		std::vector<int> worker_nodes(worker_cpus.size(), -1);
+		for (std::size_t index = 0; index < worker_cpus.size(); ++index)
+		{
+			const int cpu = worker_cpus[index];
+			if ((cpu >= 0) && (static_cast<std::size_t>(cpu) < cpu_nodes.size()))
+			{
+				worker_nodes[index] = cpu_nodes[cpu];
+			}
+		}
+
+		m_victim_order.resize(worker_cpus.size());
+		m_near_victim_count.resize(worker_cpus.size());
+		for (std::size_t thief = 0; thief < worker_cpus.size(); ++thief)
+		{
+			std::vector<unsigned> &victims = m_victim_order[thief];
+			for (unsigned pass = 0; pass < 2; ++pass)
+			{
+				for (std::size_t victim = 0; victim < worker_cpus.size(); ++victim)
+				{
+					const bool near = (worker_nodes[thief] >= 0) && (worker_nodes[victim] == worker_nodes[thief]);
+					if ((victim != thief) && (near == (pass == 0)))
+					{
+						victims.push_back(static_cast<unsigned>(victim));
+					}
+				}
+				if (pass == 0)
+				{
+					m_near_victim_count[thief] = victims.size();
+				}
+			}
+		}
+	}
+
+	void work_thread(unsigned my_index, int cpu)
+	{
+		if (cpu >= 0)
+		{
+			pin_this_thread_to_cpu(static_cast<unsigned>(cpu));
+		}
+
+		task_state_allocator state_allocator;
+		this_thread_task_state_allocator = &state_allocator;
+		sm_my_index = my_index;
+		sm_local_work_queue = m_queues[my_index].get();
+		this_thread_scheduler = this;
+		this_thread_worker_index = static_cast<int>(my_index);
+		sm_victim_random.seed(my_index + 1);
+		worker_slot &slot = m_slots[my_index];
+		if (m_fiber_mode)
+		{
+			fiber_scheduler fibers(m_fiber_stack_size);
+			sm_fibers = &fibers;
+			auto loop = [this, &slot] { run_worker_loop(slot); };
+			fibers.run(loop);
+			sm_fibers = nullptr;
+		}
+		else
+		{
+			run_worker_loop(slot);
+		}
+
+		if (!m_done)
+		{
+			migrate_local_work();
+		}
+		sm_local_work_queue = nullptr;
+		this_thread_scheduler = nullptr;
+		this_thread_worker_index = -1;
+		this_thread_task_state_allocator = nullptr;
+		slot.m_state.store(worker_state::vacant, std::memory_order_release);
+		worker_exited();
+	}
+
+	void run_worker_loop(worker_slot &slot)
+	{
+		bool idle = false;
+		bool searching = false;
+		std::chrono::steady_clock::time_point idle_mark;
+		unsigned failed_rounds = 0;
+		while ((!m_done && (slot.m_state.load(std::memory_order_acquire) == worker_state::running)) || has_suspended_fibers())
+		{
+			if ((sm_fibers != nullptr) && sm_fibers->has_ready())
+			{
+				idle = false;
+				mark_busy();
+				sm_fibers->resume_ready_fiber();
+				continue;
+			}
+
+			if (try_run_pending_task())
+			{
+				failed_rounds = 0;
+				searching = false;
+				idle = false;
+				continue;
+			}
+
+			if (m_draining && !has_pending_task() && !has_suspended_fibers())
+			{
+				break;
+			}
+
+			if (searching)
+			{
+				account_idle(idle_mark);
+			}
+			else
+			{
+				searching = true;
+				idle_mark = std::chrono::steady_clock::now();
+			}
+
+			count(my_counters().m_failed_rounds, 1);
+			if (++failed_rounds < m_policy.m_max_failed_rounds)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				failed_rounds = 0;
+				if (!idle)
+				{
+					idle = true;
+					slot.m_idle_since.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+				}
+				if (has_suspended_fibers())
+				{
+					wait_for_suspended_fibers();
+				}
+				else
+				{
+					wait_for_task(slot);
+				}
+				account_idle(idle_mark);
+			}
+		}
+	}
+
+	bool has_suspended_fibers() const
+	{
+		return (sm_fibers != nullptr) && sm_fibers->has_waiting();
+	}
+
+	template <typename Predicate>
+	void suspend_fiber_until(const Predicate &done)
+	{
+		if (done())
+		{
+			return;
+		}
+
+		worker_counters &counters = my_counters();
+		count(counters.m_fiber_suspends, 1);
+		sm_fibers->suspend_until(done);
+		counters.m_fiber_stacks.store(sm_fibers->fiber_count(), std::memory_order_relaxed);
+	}
+
+	void wait_for_suspended_fibers()
+	{
+		event_count &completion = any_task_completion_event();
+		const unsigned epoch = completion.prepare_wait();
+		if (sm_fibers->has_ready() || has_pending_task())
+		{
+			completion.cancel_wait();
+			return;
+		}
+
+		count(my_counters().m_parks, 1);
+		completion.wait_for(epoch, m_affinity_wait);
+	}
+
+	void start_worker(unsigned index)
+	{
+		m_slots[index].m_idle_since.store(0, std::memory_order_relaxed);
+		m_slots[index].m_state.store(worker_state::running, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lk(m_exit_mx);
+			++m_live_workers;
+		}
+		try
+		{
+			m_threads[index] = std::thread(&thread_pool::work_thread, this, index, m_worker_cpus[index]);
+		}
+		catch (...)
+		{
+			m_slots[index].m_state.store(worker_state::vacant, std::memory_order_release);
+			worker_exited();
+			throw;
+		}
+		m_active_threads.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void worker_exited()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_exit_mx);
+			--m_live_workers;
+		}
+		m_exit_cv.notify_all();
+	}
+
+	bool wait_for_workers(std::chrono::steady_clock::duration timeout)
+	{
+		std::unique_lock<std::mutex> lk(m_exit_mx);
+		if (timeout == std::chrono::steady_clock::duration::max())
+		{
+			m_exit_cv.wait(lk, [this] { return m_live_workers == 0; });
+			return true;
+		}
+		return m_exit_cv.wait_for(lk, timeout, [this] { return m_live_workers == 0; });
+	}
+
+	std::size_t drop_pending_tasks()
+	{
+		std::size_t dropped = 0;
+		this_thread_drop_reason = std::make_exception_ptr(pool_shutdown_error());
+		function_wrapper task;
+		while (m_pool_work_queue.try_pop(task))
+		{
+			task = function_wrapper();
+			++dropped;
+		}
+		for (auto &queue : m_queues)
+		{
+			while (queue->try_steal(task))
+			{
+				task = function_wrapper();
+				++dropped;
+			}
+		}
+		for (std::size_t index = 0; index < m_queues.size(); ++index)
+		{
+			while (m_inboxes[index].m_pinned.try_pop(task) || m_inboxes[index].m_preferred.try_pop(task))
+			{
+				task = function_wrapper();
+				++dropped;
+			}
+		}
+
+		std::vector<std::shared_ptr<timer_entry>> timers;
+		m_timers.clear(timers);
+		for (auto &entry : timers)
+		{
+			int expected = timer_entry::pending;
+			if (entry->m_state.compare_exchange_strong(expected, timer_entry::cancelled, std::memory_order_acq_rel))
+			{
+				entry->m_fn = function_wrapper();
+				++dropped;
+			}
+		}
+		this_thread_drop_reason = nullptr;
+		return dropped;
+	}
+
+	std::uint64_t tasks_run_so_far() const
+	{
+		std::uint64_t total = 0;
+		for (std::size_t index = 0; index <= m_queues.size(); ++index)
+		{
+			total += m_counters[index].m_local_tasks.load(std::memory_order_relaxed)
+				+ m_counters[index].m_pool_tasks.load(std::memory_order_relaxed)
+				+ m_counters[index].m_successes.load(std::memory_order_relaxed)
+				+ m_counters[index].m_inbox_tasks.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+	void migrate_local_work()
+	{
+		std::vector<function_wrapper> tasks;
+		function_wrapper task;
+		while (sm_local_work_queue->try_pop(task))
+		{
+			tasks.push_back(std::move(task));
+		}
+		worker_inbox &inbox = m_inboxes[sm_my_index];
+		while (inbox.m_pinned.try_pop(task) || inbox.m_preferred.try_pop(task))
+		{
+			tasks.push_back(std::move(task));
+		}
+
+		if (!tasks.empty())
+		{
+			m_pool_work_queue.push_range(task_priority::normal, tasks.begin(), tasks.end());
+			m_work_event.notify_all();
+		}
+	}
+
+	void supervise()
+	{
+		const std::chrono::milliseconds tick = std::max(std::chrono::milliseconds(1), std::min(m_spawn_wait, m_idle_retire) / 4);
+		std::unique_lock<std::mutex> lk(m_supervisor_mx);
+		while (!m_supervisor_cv.wait_for(lk, tick, [this] { return m_done.load(); }))
+		{
+			const unsigned active = m_active_threads.load(std::memory_order_relaxed);
+			if (start_worker_with_stranded_inbox())
+			{
+				continue;
+			}
+			if ((active < m_queues.size())
+				&& ((m_pool_work_queue.size() > m_spawn_queue_depth) || (m_pool_work_queue.oldest_wait() > m_spawn_wait)))
+			{
+				spawn_worker();
+			}
+			else if (active > m_min_threads)
+			{
+				retire_idle_worker();
+			}
+		}
+	}
+
+	void spawn_worker()
+	{
+		for (unsigned index = 0; index < m_queues.size(); ++index)
+		{
+			if (m_slots[index].m_state.load(std::memory_order_acquire) == worker_state::vacant)
+			{
+				if (m_threads[index].joinable())
+				{
+					m_threads[index].join();
+				}
+				start_worker(index);
+				return;
+			}
+		}
+	}
+
+	bool start_worker_with_stranded_inbox()
+	{
+		for (unsigned index = 0; index < m_queues.size(); ++index)
+		{
+			if ((m_slots[index].m_state.load(std::memory_order_acquire) == worker_state::vacant)
+				&& (!m_inboxes[index].m_pinned.empty() || !m_inboxes[index].m_preferred.empty()))
+			{
+				if (m_threads[index].joinable())
+				{
+					m_threads[index].join();
+				}
+				start_worker(index);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void retire_idle_worker()
+	{
+		const std::chrono::steady_clock::rep now = std::chrono::steady_clock::now().time_since_epoch().count();
+		const std::chrono::steady_clock::rep limit = std::chrono::duration_cast<std::chrono::steady_clock::duration>(m_idle_retire).count();
+		for (unsigned index = 0; index < m_queues.size(); ++index)
+		{
+			worker_slot &slot = m_slots[index];
+			const std::chrono::steady_clock::rep idle_since = slot.m_idle_since.load(std::memory_order_relaxed);
+			worker_state expected = worker_state::running;
+			if ((idle_since != 0) && (now - idle_since >= limit)
+				&& slot.m_state.compare_exchange_strong(expected, worker_state::retiring, std::memory_order_acq_rel))
+			{
+				m_active_threads.fetch_sub(1, std::memory_order_relaxed);
+				m_work_event.notify_all();
+				return;
+			}
+		}
+	}
+
+	void push_batch(std::vector<function_wrapper> &tasks)
+	{
+		if (m_done && (current_worker_index() < 0))
+		{
+			throw pool_shutdown_error();
+		}
+
+		if (tasks.empty())
+		{
+			return;
+		}
+
+		auto shared_begin = tasks.begin();
+		if (current_worker_index() >= 0)
+		{
+			const std::size_t local_count = (tasks.size() + m_queues.size() - 1) / m_queues.size();
+			for (std::size_t index = 0; index < local_count; ++index, ++shared_begin)
+			{
+				sm_local_work_queue->push(std::move(*shared_begin));
+			}
+		}
+
+		m_pool_work_queue.push_range(task_priority::normal, shared_begin, tasks.end());
+		m_work_event.notify_all();
+	}
+
+	void wait_for_task(const worker_slot &slot)
+	{
+		const unsigned epoch = m_work_event.prepare_wait();
+		if (m_done || m_draining || (slot.m_state.load(std::memory_order_acquire) != worker_state::running) || has_pending_task())
+		{
+			m_work_event.cancel_wait();
+			return;
+		}
+
+		count(my_counters().m_parks, 1);
+		if (has_preferred_task_elsewhere())
+		{
+			m_work_event.wait_for(epoch, m_affinity_wait);
+		}
+		else
+		{
+			m_work_event.wait(epoch);
+		}
+	}
+
+	bool has_pending_task()
+	{
+		if (!m_pool_work_queue.empty() || m_timers_due.load(std::memory_order_relaxed))
+		{
+			return true;
+		}
+
+		for (auto &queue : m_queues)
+		{
+			if (!queue->empty())
+			{
+				return true;
+			}
+		}
+
+		const int my_index = current_worker_index();
+		return (my_index >= 0) && (!m_inboxes[my_index].m_pinned.empty() || !m_inboxes[my_index].m_preferred.empty());
+	}
+
+	bool has_preferred_task_elsewhere()
+	{
+		const int my_index = current_worker_index();
+		for (std::size_t index = 0; index < m_queues.size(); ++index)
+		{
+			if ((static_cast<int>(index) != my_index) && !m_inboxes[index].m_preferred.empty())
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool pop_task_from_local_queue(function_wrapper &value)
+	{
+		if (current_worker_index() < 0)
+		{
+			return false;
+		}
+
+		if ((++sm_local_streak >= priority_task_queue<function_wrapper>::sm_aging_limit) && !m_pool_work_queue.empty())
+		{
+			sm_local_streak = 0;
+			return false;
+		}
+
+		return sm_local_work_queue->try_pop(value);
+	}
+
+	bool pop_task_from_inbox(function_wrapper &value)
+	{
+		const int my_index = current_worker_index();
+		if (my_index < 0)
+		{
+			return false;
+		}
+
+		worker_inbox &inbox = m_inboxes[my_index];
+		return inbox.m_pinned.try_pop(value) || inbox.m_preferred.try_pop(value);
+	}
+
+	bool pop_task_from_pool_queue(function_wrapper &value)
+	{
+		if (!m_pool_work_queue.try_pop(value))
+		{
+			return false;
+		}
+
+		notify_queue_space();
+		return true;
+	}
+
+	bool pop_task_from_pool_queue(function_wrapper &value, task_priority priority)
+	{
+		if (!m_pool_work_queue.try_pop(priority, value))
+		{
+			return false;
+		}
+
+		notify_queue_space();
+		return true;
+	}
+
+	void notify_queue_space()
+	{
+		if (m_queue_capacity != 0)
+		{
+			m_space_event.notify_one();
+		}
+	}
+
+	submit_status push_to_pool_queue(task_priority priority, function_wrapper task)
+	{
+		if (m_queue_capacity == 0)
+		{
+			m_pool_work_queue.push(priority, std::move(task));
+			m_work_event.notify_one();
+			return submit_status::accepted;
+		}
+
+		while (!m_pool_work_queue.try_push(priority, task, m_queue_capacity))
+		{
+			if (m_overflow_policy == overflow_policy::fail_fast)
+			{
+				this_thread_drop_reason = std::make_exception_ptr(pool_queue_full_error());
+				task = function_wrapper();
+				this_thread_drop_reason = nullptr;
+				return submit_status::rejected;
+			}
+
+			if ((m_overflow_policy == overflow_policy::caller_runs) || (current_worker_index() >= 0))
+			{
+				task();
+				return submit_status::ran_inline;
+			}
+
+			const unsigned epoch = m_space_event.prepare_wait();
+			if (m_done)
+			{
+				m_space_event.cancel_wait();
+				throw pool_shutdown_error();
+			}
+			if (m_pool_work_queue.size() < m_queue_capacity)
+			{
+				m_space_event.cancel_wait();
+				continue;
+			}
+
+			m_space_event.wait(epoch);
+		}
+
+		m_work_event.notify_one();
+		return submit_status::accepted;
+	}
+
+	bool pop_task_from_other_thread_queue(function_wrapper &value)
+	{
+		const std::size_t queue_count = m_queues.size();
+		if (queue_count == 0)
+		{
+			return false;
+		}
+
+		const bool is_worker = (current_worker_index() >= 0);
+		if (is_worker && !m_victim_order.empty())
+		{
+			const std::vector<unsigned> &victims = m_victim_order[sm_my_index];
+			const std::size_t near_count = m_near_victim_count[sm_my_index];
+			return steal_from_victims(victims.data(), near_count, value)
+				|| steal_from_victims(victims.data() + near_count, victims.size() - near_count, value);
+		}
+
+		const std::size_t first_victim = (m_policy.m_victims == victim_selection::random)
+			? sm_victim_random() % queue_count
+			: (sm_my_index + 1) % queue_count;
+		for (std::size_t index = 0; index < queue_count; ++index)
+		{
+			const std::size_t victim = (first_victim + index) % queue_count;
+			if (is_worker && (victim == sm_my_index))
+			{
+				continue;
+			}
+
+			if (try_steal_from(victim, value))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool steal_from_victims(const unsigned *victims, std::size_t victim_count, function_wrapper &value)
+	{
+		if (victim_count == 0)
+		{
+			return false;
+		}
+
+		const std::size_t first_victim = (m_policy.m_victims == victim_selection::random)
+			? sm_victim_random() % victim_count
+			: 0;
+		for (std::size_t index = 0; index < victim_count; ++index)
+		{
+			if (try_steal_from(victims[(first_victim + index) % victim_count], value))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool try_steal_from(std::size_t victim, function_wrapper &value)
+	{
+		worker_counters &counters = my_counters();
+		count(counters.m_attempts, 1);
+		if (!m_queues[victim]->try_steal(value))
+		{
+			return false;
+		}
+
+		std::uint64_t stolen = 1;
+		if (m_policy.m_steal_half && (current_worker_index() >= 0))
+		{
+			stolen += steal_half_into_local_queue(*m_queues[victim]);
+		}
+		count(counters.m_successes, 1);
+		count(counters.m_tasks_stolen, stolen);
+		return true;
+	}
+
+	bool try_leapfrog(std::size_t thief, function_wrapper &value)
+	{
+		worker_counters &counters = my_counters();
+		count(counters.m_attempts, 1);
+		if (!m_queues[thief]->try_steal(value))
+		{
+			return false;
+		}
+
+		count(counters.m_successes, 1);
+		count(counters.m_tasks_stolen, 1);
+		return true;
+	}
+
+	bool steal_overdue_preferred_task(function_wrapper &value)
+	{
+		const int my_index = current_worker_index();
+		std::chrono::steady_clock::time_point cutoff;
+		for (std::size_t index = 0; index < m_queues.size(); ++index)
+		{
+			task_inbox &preferred = m_inboxes[index].m_preferred;
+			if ((static_cast<int>(index) == my_index) || preferred.empty())
+			{
+				continue;
+			}
+
+			if (cutoff == std::chrono::steady_clock::time_point())
+			{
+				cutoff = std::chrono::steady_clock::now() - m_affinity_wait;
+			}
+			if (preferred.try_pop_enqueued_before(cutoff, value))
+			{
+				worker_counters &counters = my_counters();
+				count(counters.m_successes, 1);
+				count(counters.m_tasks_stolen, 1);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	std::uint64_t steal_half_into_local_queue(WorkStealingQueue &victim)
+	{
+		const std::size_t batch = victim.size() / 2;
+		std::uint64_t stolen = 0;
+		function_wrapper task;
+		while ((stolen < batch) && victim.try_steal(task))
+		{
+			sm_local_work_queue->push(std::move(task));
+			++stolen;
+		}
+		return stolen;
+	}
+
+	worker_counters &my_counters()
+	{
+		const int my_index = current_worker_index();
+		return m_counters[(my_index >= 0) ? static_cast<std::size_t>(my_index) : m_queues.size()];
+	}
+
+	timer_handle add_timer(std::chrono::steady_clock::time_point when, std::chrono::steady_clock::duration period, function_wrapper fn)
+	{
+		if (m_done)
+		{
+			throw pool_shutdown_error();
+		}
+
+		std::call_once(m_timer_thread_started, [this] { m_timer_thread = std::thread(&thread_pool::run_timer_thread, this); });
+		std::shared_ptr<timer_entry> entry;
+		{
+			std::lock_guard<std::mutex> lk(m_timer_mx);
+			entry = std::make_shared<timer_entry>(std::move(fn), m_timers.deadline_tick(when),
+				(period == std::chrono::steady_clock::duration::zero()) ? 0 : m_timers.period_ticks(period));
+			m_timers.insert(entry);
+		}
+		m_timer_cv.notify_one();
+		return timer_handle(entry);
+	}
+
+	void run_timer_thread()
+	{
+		std::unique_lock<std::mutex> lk(m_timer_mx);
+		while (!m_done)
+		{
+			if (m_timers_due.load(std::memory_order_relaxed) || m_timers.empty())
+			{
+				m_timer_cv.wait(lk);
+				continue;
+			}
+
+			const std::chrono::steady_clock::time_point next = m_timers.tick_time(m_timers.next_expiry());
+			if ((m_timer_cv.wait_until(lk, next) == std::cv_status::timeout) || (std::chrono::steady_clock::now() >= next))
+			{
+				m_timers_due.store(true, std::memory_order_relaxed);
+				m_work_event.notify_one();
+			}
+		}
+	}
+
+	void service_timers()
+	{
+		std::vector<std::shared_ptr<timer_entry>> expired;
+		{
+			std::unique_lock<std::mutex> lk(m_timer_mx, std::try_to_lock);
+			if (!lk.owns_lock() || !m_timers_due.exchange(false, std::memory_order_relaxed))
+			{
+				return;
+			}
+			m_timers.advance(m_timers.now_tick(), expired);
+		}
+		m_timer_cv.notify_one();
+
+		for (auto &entry : expired)
+		{
+			if (entry->m_period != 0)
+			{
+				sm_local_work_queue->push([this, entry] { run_periodic(entry); });
+				continue;
+			}
+
+			int expected = timer_entry::pending;
+			if (entry->m_state.compare_exchange_strong(expected, timer_entry::fired, std::memory_order_acq_rel))
+			{
+				sm_local_work_queue->push(std::move(entry->m_fn));
+			}
+		}
+		if (expired.size() > 1)
+		{
+			m_work_event.notify_all();
+		}
+	}
+
+	void run_periodic(const std::shared_ptr<timer_entry> &entry)
+	{
+		if (entry->m_state.load(std::memory_order_acquire) != timer_entry::pending)
+		{
+			return;
+		}
+
+		entry->m_fn();
+		{
+			std::lock_guard<std::mutex> lk(m_timer_mx);
+			const std::uint64_t now = m_timers.now_tick();
+			do
+			{
+				entry->m_deadline += entry->m_period;
+			} while (entry->m_deadline <= now);
+			m_timers.insert(entry);
+		}
+		m_timer_cv.notify_one();
+	}
+
+	void account_idle(std::chrono::steady_clock::time_point &idle_mark)
+	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		count(my_counters().m_idle_ns, std::chrono::duration_cast<std::chrono::nanoseconds>(now - idle_mark).count());
+		idle_mark = now;
+	}
+
+	void count(std::atomic<std::uint64_t> &counter, std::uint64_t amount)
+	{
+		if (current_worker_index() >= 0)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+		else
+		{
+			counter.fetch_add(amount, std::memory_order_relaxed);
+		}
+	}
+};
+
+template <typename WorkStealingQueue>
+thread_local WorkStealingQueue* thread_pool<WorkStealingQueue>::sm_local_work_queue = nullptr;
+template <typename WorkStealingQueue>
+thread_local unsigned thread_pool<WorkStealingQueue>::sm_my_index = 0;
+template <typename WorkStealingQueue>
+thread_local std::minstd_rand thread_pool<WorkStealingQueue>::sm_victim_random;
+
+template <typename WorkStealingQueue>
+thread_local unsigned thread_pool<WorkStealingQueue>::sm_local_streak = 0;
+template <typename WorkStealingQueue>
+thread_local fiber_scheduler *thread_pool<WorkStealingQueue>::sm_fibers = nullptr;
+
+template <typename ThreadPool>
+class task_group
+{
+public:
+	explicit task_group(ThreadPool &pool)
+		: m_pool(pool), m_owner(pool.current_worker_index()), m_runner(-1), m_pending(0), m_has_exception(false)
+	{
+
+	}
+
+	~task_group()
+	{
+		wait_for_children();
+	}
+
+	task_group(const task_group&) = delete;
+	task_group &operator=(const task_group&) = delete;
+
+	template <typename F>
+	void run(F f)
+	{
+		m_pending.fetch_add(1, std::memory_order_relaxed);
+		m_pool.schedule([this, f = std::move(f)]() mutable
+		{
+			const int runner = m_pool.current_worker_index();
+			if ((runner != m_owner) && (m_runner.load(std::memory_order_relaxed) == -1))
+			{
+				int unset = -1;
+				m_runner.compare_exchange_strong(unset, runner, std::memory_order_relaxed);
+			}
+
+			try
+			{
+				f();
+			}
+			catch (...)
+			{
+				if (!m_has_exception.exchange(true, std::memory_order_acq_rel))
+				{
+					m_exception = std::current_exception();
+				}
+			}
+
+			if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				notify_task_completion(this);
+			}
+		});
+	}
+
+	void wait()
+	{
+		wait_for_children();
+		if (m_has_exception.load(std::memory_order_acquire))
+		{
+			std::exception_ptr exception = m_exception;
+			m_exception = nullptr;
+			m_has_exception.store(false, std::memory_order_relaxed);
+			std::rethrow_exception(exception);
+		}
+	}
+
+private:
+	ThreadPool &m_pool;
+	const int m_owner;
+	std::atomic<int> m_runner;
+	std::atomic<std::size_t> m_pending;
+	std::atomic<bool> m_has_exception;
+	std::exception_ptr m_exception;
+
+	void wait_for_children()
+	{
+		m_pool.help_until([this] { return m_pending.load(std::memory_order_acquire) == 0; },
+			[this] { return m_runner.load(std::memory_order_relaxed); }, task_completion_event(this));
+	}
+};
+
+template <typename ThreadPool>
+class task_graph
+{
+public:
+	using node_id = std::size_t;
+
+	explicit task_graph(ThreadPool &pool)
+		: m_pool(pool), m_remaining(0), m_has_exception(false), m_validated(true)
+	{
+
+	}
+
+	task_graph(const task_graph&) = delete;
+	task_graph &operator=(const task_graph&) = delete;
+
+	template <typename F>
+	node_id add(F f)
+	{
+		m_nodes.push_back(std::make_unique<node>(m_nodes.size(), std::move(f)));
+		m_validated = false;
+		return m_nodes.size() - 1;
+	}
+
+	void precede(node_id before, node_id after)
+	{
+		if ((before >= m_nodes.size()) || (after >= m_nodes.size()) || (before == after))
+		{
+			throw std::invalid_argument("task_graph::precede: bad edge");
+		}
+
+		m_nodes[before]->m_successors.push_back(m_nodes[after].get());
+		++m_nodes[after]->m_predecessor_count;
+		m_validated = false;
+	}
+
+	std::size_t size() const
+	{
+		return m_nodes.size();
+	}
+
+	void run()
+	{
+		if (m_nodes.empty())
+		{
+			return;
+		}
+
+		if (!m_validated)
+		{
+			validate();
+		}
+
+		for (auto &n : m_nodes)
+		{
+			n->m_pending.store(n->m_predecessor_count, std::memory_order_relaxed);
+		}
+		m_has_exception.store(false, std::memory_order_relaxed);
+		m_exception = nullptr;
+		m_remaining.store(m_nodes.size(), std::memory_order_release);
+
+		for (node *root : m_roots)
+		{
+			m_pool.schedule([this, root] { execute(root); });
+		}
+		m_pool.help_until([this] { return m_remaining.load(std::memory_order_acquire) == 0; }, task_completion_event(this));
+
+		if (m_has_exception.load(std::memory_order_acquire))
+		{
+			std::rethrow_exception(m_exception);
+		}
+	}
+
+private:
+	struct node
+	{
+		template <typename F>
+		node(std::size_t index, F f)
+			: m_index(index), m_work(std::move(f)), m_predecessor_count(0), m_pending(0)
+		{
+
+		}
+
+		const std::size_t m_index;
+		function_wrapper m_work;
+		std::vector<node*> m_successors;
+		std::size_t m_predecessor_count;
+		std::atomic<std::size_t> m_pending;
+	};
+
+	ThreadPool &m_pool;
+	std::vector<std::unique_ptr<node>> m_nodes;
+	std::vector<node*> m_roots;
+	std::atomic<std::size_t> m_remaining;
+	std::atomic<bool> m_has_exception;
+	std::exception_ptr m_exception;
+	bool m_validated;
+
+	void validate()
+	{
+		std::vector<std::size_t> pending;
+		std::vector<node*> ready;
+		m_roots.clear();
+		for (std::size_t index = 0; index < m_nodes.size(); ++index)
+		{
+			pending.push_back(m_nodes[index]->m_predecessor_count);
+			if (m_nodes[index]->m_predecessor_count == 0)
+			{
+				m_roots.push_back(m_nodes[index].get());
+				ready.push_back(m_nodes[index].get());
+			}
+		}
+
+		std::size_t visited = 0;
+		while (!ready.empty())
+		{
+			node *const current = ready.back();
+			ready.pop_back();
+			++visited;
+			for (node *successor : current->m_successors)
+			{
+				if (--pending[successor->m_index] == 0)
+				{
+					ready.push_back(successor);
+				}
+			}
+		}
+
+		if (visited != m_nodes.size())
+		{
+			throw std::logic_error("task_graph: dependency cycle");
+		}
+		m_validated = true;
+	}
+
+	void execute(node *current)
+	{
+		while (current != nullptr)
+		{
+			if (!m_has_exception.load(std::memory_order_relaxed))
+			{
+				try
+				{
+					current->m_work();
+				}
+				catch (...)
+				{
+					if (!m_has_exception.exchange(true, std::memory_order_acq_rel))
+					{
+						m_exception = std::current_exception();
+					}
+				}
+			}
+
+			node *next = nullptr;
+			for (node *successor : current->m_successors)
+			{
+				if (successor->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					if (next == nullptr)
+					{
+						next = successor;
+					}
+					else
+					{
+						m_pool.schedule([this, successor] { execute(successor); });
+					}
+				}
+			}
+
+			if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				notify_task_completion(this);
+			}
+			current = next;
+		}
+	}
+};
+
+template <typename ThreadPool>
+class stats_reporter
+{
+public:
+	stats_reporter(ThreadPool &pool, std::ostream &out, std::chrono::milliseconds interval)
+		: m_pool(pool), m_out(out), m_interval(interval), m_done(false), m_thread(&stats_reporter::report, this)
+	{
+
+	}
+
+	stats_reporter(const stats_reporter&) = delete;
+	stats_reporter &operator=(const stats_reporter&) = delete;
+
+	~stats_reporter()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mx);
+			m_done = true;
+		}
+		m_cv.notify_all();
+		m_thread.join();
+	}
+
+private:
+	ThreadPool &m_pool;
+	std::ostream &m_out;
+	const std::chrono::milliseconds m_interval;
+	bool m_done;
+	std::mutex m_mx;
+	std::condition_variable m_cv;
+	std::thread m_thread;
+
+	void report()
+	{
+		std::unique_lock<std::mutex> lk(m_mx);
+		while (!m_cv.wait_for(lk, m_interval, [this] { return m_done; }))
+		{
+			write_json(m_out, m_pool.stats()) << std::endl;
+		}
+	}
+};
+
+template <typename T, typename WorkStealingQueue = lock_free_work_stealing_queue>
+struct sorter
+{
+	thread_pool<WorkStealingQueue> m_tp;
+
+	sorter() = default;
+
+	explicit sorter(thread_pool_options options)
+		: m_tp(std::move(options))
+	{
+
+	}
+
+	std::list<T> do_sort(std::list<T> &chunk_data)
+	{
+		if (chunk_data.empty())
+		{
+			return chunk_data;
+		}
+
+		std::list<T> result;
+		result.splice(result.begin(), chunk_data, chunk_data.begin());
+		const T &partition_val = *result.begin();
+
+		typename std::list<T>::iterator divide_it = std::partition(chunk_data.begin(), chunk_data.end(),
+			[&](const T &val) { return val < partition_val; });
+		
+		std::list<T> new_lower_chunk;
+		new_lower_chunk.splice(new_lower_chunk.end(), chunk_data, chunk_data.begin(), divide_it);
+		std::list<T> new_lower;
+		std::list<T> new_higher;
+		m_tp.parallel_invoke(
+			[&] { new_higher = do_sort(chunk_data); },
+			[&] { new_lower = do_sort(new_lower_chunk); });
+
+		result.splice(result.end(), new_higher);
+		result.splice(result.begin(), new_lower);
+		return result;
+	}
+};
+
+template <typename T, typename WorkStealingQueue = lock_free_work_stealing_queue>
 std::list<T> parallel_quick_sort(std::list<T> input)
 {
 	if (input.empty())
@@ -337,10 +4425,254 @@ std::list<T> parallel_quick_sort(std::list<T> input)
 		return input;
 	}
 
-	sorter<T> s;
+	sorter<T, WorkStealingQueue> s;
 	return s.do_sort(input);
 }
 
+template <typename Iterator, typename MatchType, typename WorkStealingQueue>
+Iterator parallel_find(thread_pool<WorkStealingQueue> &pool, Iterator first, Iterator last, MatchType match)
+{
+	const std::size_t length = std::distance(first, last);
+	const std::size_t min_block_size = 4096;
+	const std::size_t block_size = std::max(min_block_size, length / (pool.thread_count() * 8 + 1));
+	cancellation_source found;
+	std::vector<task_future<Iterator>> blocks;
+	for (Iterator block_start = first; block_start != last;)
+	{
+		Iterator block_end = block_start;
+		std::advance(block_end, std::min<std::size_t>(block_size, std::distance(block_start, last)));
+		blocks.push_back(pool.submit(found.token(), [block_start, block_end, last, match, &found]
+		{
+			std::size_t checked = 0;
+			for (Iterator it = block_start; it != block_end; ++it)
+			{
+				if ((++checked % 1024) == 0)
+				{
+					interruption_point();
+				}
+				if (*it == match)
+				{
+					found.cancel();
+					return it;
+				}
+			}
+			return last;
+		}));
+		block_start = block_end;
+	}
+
+	Iterator result = last;
+	std::exception_ptr error;
+	for (auto &block : blocks)
+	{
+		pool.wait(block);
+		try
+		{
+			const Iterator it = block.get();
+			if ((it != last) && (result == last))
+			{
+				result = it;
+			}
+		}
+		catch (const task_cancelled&)
+		{
+
+		}
+		catch (...)
+		{
+			found.cancel();
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	return result;
+}
+
+std::vector<double> probe_latencies(task_priority probe_priority)
+{
+	thread_pool<> tp;
+	const auto busy_for = [](std::chrono::microseconds duration)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + duration;
+		while (std::chrono::steady_clock::now() < deadline)
+		{
+
+		}
+	};
+
+	std::vector<task_future<void>> load;
+	for (std::size_t index = 0; index < tp.thread_count() * 2000; ++index)
+	{
+		load.push_back(tp.submit(task_priority::background, [busy_for] { busy_for(std::chrono::microseconds(50)); }));
+	}
+
+	std::vector<task_future<double>> probes;
+	for (int index = 0; index < 50; ++index)
+	{
+		const auto submitted = std::chrono::steady_clock::now();
+		probes.push_back(tp.submit(probe_priority, [submitted]
+		{
+			return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - submitted).count();
+		}));
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	std::vector<double> latencies;
+	for (auto &probe : probes)
+	{
+		latencies.push_back(probe.get());
+	}
+	for (auto &task : load)
+	{
+		task.wait();
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	return latencies;
+}
+
+void report_overflow_policy(overflow_policy policy, const char *name)
+{
+	thread_pool_options options;
+	options.m_queue_capacity = 64;
+	options.m_overflow_policy = policy;
+	thread_pool<> bounded(options);
+	std::size_t counts[3] = {};
+	std::vector<task_future<void>> accepted;
+	const auto burst_start = std::chrono::steady_clock::now();
+	for (int index = 0; index < 2000; ++index)
+	{
+		submit_result<void> res = bounded.try_submit([]
+		{
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+			while (std::chrono::steady_clock::now() < deadline)
+			{
+
+			}
+		});
+		++counts[static_cast<std::size_t>(res.m_status)];
+		if (res.m_status == submit_status::accepted)
+		{
+			accepted.push_back(std::move(res.m_future));
+		}
+	}
+	const auto burst_time = std::chrono::steady_clock::now() - burst_start;
+	for (auto &task : accepted)
+	{
+		task.wait();
+	}
+
+	std::cout << name << ": accepted " << counts[static_cast<std::size_t>(submit_status::accepted)]
+		<< ", rejected " << counts[static_cast<std::size_t>(submit_status::rejected)]
+		<< ", ran inline " << counts[static_cast<std::size_t>(submit_status::ran_inline)]
+		<< ", high water " << bounded.queue_high_water_mark() << "/" << options.m_queue_capacity
+		<< ", submit loop " << std::chrono::duration_cast<std::chrono::milliseconds>(burst_time).count() << "ms" << std::endl;
+}
+
+template <typename WorkStealingQueue>
+std::uint64_t parallel_fib(thread_pool<WorkStealingQueue> &pool, unsigned n)
+{
+	if (n < 2)
+	{
+		return n;
+	}
+
+	std::uint64_t left = 0;
+	std::uint64_t right = 0;
+	pool.parallel_invoke(
+		[&] { left = parallel_fib(pool, n - 1); },
+		[&] { right = parallel_fib(pool, n - 2); });
+	return left + right;
+}
+
+void report_help_depth(unsigned max_help_depth)
+{
+	thread_pool_options options;
+	options.m_max_help_depth = max_help_depth;
+	thread_pool<> pool(options);
+	const auto start = std::chrono::steady_clock::now();
+	const std::uint64_t result = pool.submit([&pool] { return parallel_fib(pool, 24); }).get();
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+
+	const pool_statistics stats = pool.stats();
+	std::uint64_t deepest = stats.m_external.m_max_help_depth;
+	std::uint64_t stand_ins = stats.m_external.m_stand_ins;
+	for (const auto &worker : stats.m_workers)
+	{
+		deepest = std::max(deepest, worker.m_max_help_depth);
+		stand_ins += worker.m_stand_ins;
+	}
+	std::cout << "fib(24) = " << result << " with help depth cap " << max_help_depth
+		<< ": max help depth " << deepest << ", stand-in threads " << stand_ins
+		<< ", " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms" << std::endl;
+}
+
+void report_quicksort_waits(const std::list<int> &input, bool fiber_mode)
+{
+	thread_pool_options options;
+	options.m_fiber_mode = fiber_mode;
+	sorter<int> s(options);
+	std::list<int> data(input);
+	const auto start = std::chrono::steady_clock::now();
+	const std::list<int> sorted = s.m_tp.submit([&s, &data] { return s.do_sort(data); }).get();
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+
+	const pool_statistics stats = s.m_tp.stats();
+	std::uint64_t deepest = 0;
+	std::uint64_t suspends = 0;
+	std::uint64_t stacks = 0;
+	for (const auto &worker : stats.m_workers)
+	{
+		deepest = std::max(deepest, worker.m_max_help_depth);
+		suspends += worker.m_fiber_suspends;
+		stacks += worker.m_fiber_stacks;
+	}
+	std::cout << (fiber_mode ? "fiber mode" : "help while waiting") << ": quicksort of " << input.size() << " in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms, max help depth " << deepest
+		<< ", fiber suspends " << suspends << ", fiber stacks " << stacks
+		<< ", sorted " << std::boolalpha << std::is_sorted(sorted.begin(), sorted.end()) << std::endl;
+}
+
+void report_blocking_gets()
+{
+	if (!fiber_scheduler::supported())
+	{
+		return;
+	}
+
+	thread_pool_options options;
+	options.m_thread_count = 1;
+	options.m_fiber_mode = true;
+	thread_pool<> pool(options);
+	std::vector<task_future<int>> outer;
+	for (int index = 0; index < 16; ++index)
+	{
+		outer.push_back(pool.submit([&pool, index]
+		{
+			task_future<int> inner = pool.submit([index] { return index * index; });
+			return inner.get() + 1;
+		}));
+	}
+
+	int total = 0;
+	for (auto &result : outer)
+	{
+		total += result.get();
+	}
+
+	const pool_statistics stats = pool.stats();
+	std::cout << "blocking get() on one fiber-mode worker: total " << total
+		<< ", fiber suspends " << stats.m_workers[0].m_fiber_suspends
+		<< ", fiber stacks " << stats.m_workers[0].m_fiber_stacks << std::endl;
+}
+
 int main()
 {
 	std::list<int> ln;
@@ -356,6 +4688,271 @@ int main()
 	{
 		std::cout << data << " ";
 	}
+	std::cout << std::endl;
+
+	std::list<int> big;
+	std::uniform_int_distribution<> big_dis(1, 100000000);
+	for (int index = 0; index < 10000; ++index)
+	{
+		big.push_back(big_dis(dre));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto sorted_with_mutex = parallel_quick_sort<int, work_stealing_queue>(big);
+	auto mutex_time = std::chrono::steady_clock::now() - start;
+	start = std::chrono::steady_clock::now();
+	auto sorted_lock_free = parallel_quick_sort<int, lock_free_work_stealing_queue>(big);
+	auto lock_free_time = std::chrono::steady_clock::now() - start;
+	std::cout << "work_stealing_queue: " << std::chrono::duration_cast<std::chrono::milliseconds>(mutex_time).count() << "ms" << std::endl;
+	std::cout << "lock_free_work_stealing_queue: " << std::chrono::duration_cast<std::chrono::milliseconds>(lock_free_time).count() << "ms" << std::endl;
+	std::cout << std::boolalpha << (sorted_with_mutex == sorted_lock_free) << std::endl;
+
+	std::cout << "default thread count: " << default_thread_count() << ", container cpu quota: " << container_cpu_quota() << std::endl;
+	thread_pool_options options;
+	options.m_pin_threads = true;
+	options.m_numa_aware_stealing = true;
+	thread_pool<> tp(options);
+	std::vector<task_future<std::size_t>> squares = tp.submit_n(1000, [](std::size_t index) { return index * index; });
+	task_future<std::size_t> sum_of_squares = when_all(std::move(squares)).then([](task_future<std::vector<task_future<std::size_t>>> ready)
+	{
+		std::size_t sum = 0;
+		for (auto &square : ready.get())
+		{
+			sum += square.get();
+		}
+		return sum;
+	});
+	std::cout << sum_of_squares.get() << std::endl;
+
+	{
+		auto first = make_pooled_task([] { return 1; });
+		auto second = make_pooled_task([] { return 2; });
+		auto third = make_pooled_task([] { return 3; });
+		std::vector<task_future<int>> racers;
+		racers.push_back(first.get_future());
+		racers.push_back(second.get_future());
+		racers.push_back(third.get_future());
+		task_future<when_any_result<int>> race = when_any(std::move(racers));
+		second();
+		when_any_result<int> winner = race.get();
+		std::vector<task_future<int>> losers;
+		for (std::size_t index = 0; index < winner.m_futures.size(); ++index)
+		{
+			if (index != winner.m_index)
+			{
+				losers.push_back(std::move(winner.m_futures[index]));
+			}
+		}
+
+		task_future<when_any_result<int>> rematch = when_any(std::move(losers));
+		const bool rematch_early = rematch.is_ready();
+		first();
+		when_any_result<int> runner_up = rematch.get();
+		task_future<int> last = runner_up.m_futures[1].then([](task_future<int> ready) { return ready.get() * 10; });
+		const bool then_early = last.is_ready();
+		third();
+		std::cout << std::boolalpha << "when_any winner " << winner.m_index
+			<< ", rematch early " << rematch_early << ", rematch winner " << runner_up.m_index
+			<< " ready " << runner_up.m_futures[runner_up.m_index].is_ready()
+			<< ", then early " << then_early << ", then " << last.get() << std::endl;
+	}
+
+	const steal_statistics stats = tp.steal_stats();
+	std::cout << "steals: " << stats.m_successes << "/" << stats.m_attempts
+		<< ", tasks stolen: " << stats.m_tasks_stolen
+		<< ", failed rounds: " << stats.m_failed_rounds
+		<< ", parks: " << stats.m_parks << std::endl;
+	write_json(std::cout, tp.stats()) << std::endl;
+
+	thread_pool_options elastic_options;
+	elastic_options.m_thread_count = 1;
+	elastic_options.m_max_threads = 4;
+	elastic_options.m_idle_retire = std::chrono::milliseconds(100);
+	thread_pool<> elastic(elastic_options);
+	{
+		stats_reporter<thread_pool<>> reporter(elastic, std::cout, std::chrono::milliseconds(50));
+		std::vector<task_future<void>> blocking;
+		for (int index = 0; index < 16; ++index)
+		{
+			blocking.push_back(elastic.submit([] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }));
+		}
+		for (auto &task : blocking)
+		{
+			task.wait();
+		}
+	}
+	std::cout << "elastic pool after blocking burst: " << elastic.thread_count() << " threads";
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	std::cout << ", after idling: " << elastic.thread_count() << " threads" << std::endl;
+
+	{
+		std::atomic<int> ticks(0);
+		thread_pool<> timers;
+		const auto timers_start = std::chrono::steady_clock::now();
+		scheduled_task<long long> delayed = timers.submit_after(std::chrono::milliseconds(30), [timers_start]
+		{
+			return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - timers_start).count());
+		});
+		scheduled_task<int> cancelled = timers.submit_after(std::chrono::seconds(10), [] { return 0; });
+		timer_handle periodic = timers.submit_every(std::chrono::milliseconds(10), [&ticks] { ++ticks; });
+		std::cout << "delayed task ran after " << delayed.m_future.get() << "ms" << std::endl;
+		std::cout << std::boolalpha << cancelled.m_handle.cancel();
+		try
+		{
+			cancelled.m_future.get();
+		}
+		catch (const task_cancelled &e)
+		{
+			std::cout << ", cancelled task: " << e.what() << std::endl;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		periodic.cancel();
+		std::cout << "periodic task ran " << ticks.load() << " times in ~130ms" << std::endl;
+	}
+
+	for (task_priority priority : { task_priority::high, task_priority::background })
+	{
+		const std::vector<double> latencies = probe_latencies(priority);
+		std::cout << (priority == task_priority::high ? "high" : "background")
+			<< " probes under background load: p50 " << latencies[latencies.size() / 2]
+			<< "us, p99 " << latencies[latencies.size() * 99 / 100] << "us" << std::endl;
+	}
+
+	{
+		thread_pool<> sharded;
+		const std::size_t shard_count = sharded.thread_count();
+		std::vector<std::uint64_t> shard_totals(shard_count, 0);
+		std::atomic<int> misplaced(0);
+		std::vector<task_future<void>> updates;
+		for (std::size_t index = 0; index < 10000; ++index)
+		{
+			const std::size_t shard = index % shard_count;
+			updates.push_back(sharded.submit_to(shard, [&sharded, &shard_totals, &misplaced, shard, index]
+			{
+				if (sharded.current_worker_index() != static_cast<int>(shard))
+				{
+					++misplaced;
+				}
+				shard_totals[shard] += index;
+			}));
+		}
+		for (auto &update : updates)
+		{
+			update.wait();
+		}
+		std::cout << "sharded total: " << std::accumulate(shard_totals.begin(), shard_totals.end(), std::uint64_t(0))
+			<< ", tasks off their shard: " << misplaced.load() << std::endl;
+
+		task_future<void> blocker = sharded.submit_to(0, [] { std::this_thread::sleep_for(std::chrono::milliseconds(50)); });
+		task_future<int> overdue = sharded.submit_to(0, [&sharded] { return sharded.current_worker_index(); }, task_affinity::preferred);
+		std::cout << "preferred task for busy worker 0 ran on worker " << overdue.get() << std::endl;
+		blocker.wait();
+	}
+
+	{
+		thread_pool<> cancellable;
+		cancellation_source request;
+		std::mutex wait_mx;
+		std::condition_variable never_notified;
+		std::vector<task_future<void>> subtasks;
+		subtasks.push_back(cancellable.submit(request.token(), [&wait_mx, &never_notified]
+		{
+			std::unique_lock<std::mutex> lk(wait_mx);
+			interruptible_wait(never_notified, lk, [] { return false; });
+		}));
+		for (int index = 0; index < 200; ++index)
+		{
+			subtasks.push_back(cancellable.submit(request.token(), []
+			{
+				for (int step = 0; step < 100; ++step)
+				{
+					interruption_point();
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+			}));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		request.cancel();
+		int completed = 0;
+		int cancelled = 0;
+		for (auto &subtask : subtasks)
+		{
+			try
+			{
+				subtask.get();
+				++completed;
+			}
+			catch (const task_cancelled&)
+			{
+				++cancelled;
+			}
+		}
+		std::cout << "abandoned request: " << completed << " subtasks completed, " << cancelled << " cancelled" << std::endl;
+
+		std::vector<int> haystack(10000000);
+		std::iota(haystack.begin(), haystack.end(), 0);
+		const auto find_start = std::chrono::steady_clock::now();
+		const auto found = parallel_find(cancellable, haystack.begin(), haystack.end(), 12345);
+		const auto find_time = std::chrono::steady_clock::now() - find_start;
+		const auto missing_start = std::chrono::steady_clock::now();
+		const bool missing = parallel_find(cancellable, haystack.begin(), haystack.end(), -1) == haystack.end();
+		const auto missing_time = std::chrono::steady_clock::now() - missing_start;
+		std::cout << "parallel_find: found " << *found << " in "
+			<< std::chrono::duration_cast<std::chrono::microseconds>(find_time).count() << "us, missing value "
+			<< std::boolalpha << missing << " after "
+			<< std::chrono::duration_cast<std::chrono::microseconds>(missing_time).count() << "us" << std::endl;
+	}
+
+	{
+		thread_pool<> staged;
+		std::vector<int> input(1 << 16);
+		std::vector<long long> partial(4, 0);
+		long long joined = 0;
+		task_graph<thread_pool<>> graph(staged);
+		const auto parse = graph.add([&input] { std::iota(input.begin(), input.end(), 0); });
+		const auto join = graph.add([&partial, &joined] { joined = std::accumulate(partial.begin(), partial.end(), 0LL); });
+		for (std::size_t index = 0; index < partial.size(); ++index)
+		{
+			const auto transform = graph.add([&input, &partial, index]
+			{
+				const std::size_t chunk = input.size() / partial.size();
+				partial[index] = std::accumulate(input.begin() + index * chunk, input.begin() + (index + 1) * chunk, 0LL);
+			});
+			graph.precede(parse, transform);
+			graph.precede(transform, join);
+		}
+
+		const long long expected = (static_cast<long long>(input.size()) - 1) * static_cast<long long>(input.size()) / 2;
+		const int graph_runs = 1000;
+		bool consistent = true;
+		const auto graph_start = std::chrono::steady_clock::now();
+		for (int run = 0; run < graph_runs; ++run)
+		{
+			joined = 0;
+			graph.run();
+			consistent = consistent && (joined == expected);
+		}
+		const auto graph_time = std::chrono::steady_clock::now() - graph_start;
+		std::cout << "task_graph: " << graph_runs << " runs of parse -> " << partial.size() << " transforms -> join, "
+			<< std::chrono::duration_cast<std::chrono::microseconds>(graph_time).count() / graph_runs << "us per run, consistent "
+			<< std::boolalpha << consistent << std::endl;
+	}
+
+	report_overflow_policy(overflow_policy::block, "block");
+	report_overflow_policy(overflow_policy::fail_fast, "fail_fast");
+	report_overflow_policy(overflow_policy::caller_runs, "caller_runs");
+
+	report_help_depth(thread_pool_options().m_max_help_depth);
+	report_help_depth(2);
+
+	std::list<int> deep;
+	for (int index = 0; index < 200000; ++index)
+	{
+		deep.push_back(big_dis(dre));
+	}
+	report_quicksort_waits(deep, false);
+	report_quicksort_waits(deep, true);
+	report_blocking_gets();
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,3517 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <list>
+#include <deque>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <exception>
+#include <coroutine>
+#include <optional>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <cctype>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+class join_threads
+{
+public:
+	join_threads(std::vector<std::thread> &threads)
+		: m_threads(threads)
+	{
+
+	}
+
+	~join_threads()
+	{
+		for (auto &t : m_threads)
+		{
+			if (t.joinable())
+			{
+				t.join();
+			}
+		}
+	}
+private:
+	std::vector<std::thread> &m_threads;
+};
+
+enum class task_priority
+{
+	high,
+	normal,
+	background
+};
+
+template <typename T>
+class priority_task_queue
+{
+public:
+	static const std::size_t sm_lane_count = 3;
+	static const unsigned sm_aging_limit = 8;
+
+	priority_task_queue()
+		: m_passed_over()
+	{
+		for (auto &size : m_sizes)
+		{
+			size.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	~priority_task_queue() = default;
+
+	void push(task_priority priority, T data)
+	{
+		const std::size_t lane = static_cast<std::size_t>(priority);
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lk(m_mx);
+		m_lanes[lane].push(entry{ std::move(data), now });
+		m_sizes[lane].fetch_add(1, std::memory_order_release);
+	}
+
+	template <typename Iterator>
+	void push_range(task_priority priority, Iterator first, Iterator last)
+	{
+		const std::size_t lane = static_cast<std::size_t>(priority);
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lk(m_mx);
+		for (; first != last; ++first)
+		{
+			m_lanes[lane].push(entry{ std::move(*first), now });
+		}
+		m_sizes[lane].store(m_lanes[lane].size(), std::memory_order_release);
+	}
+
+	bool try_pop(T &value)
+	{
+		std::lock_guard<std::mutex> lk(m_mx);
+		std::size_t chosen = 0;
+		while ((chosen < sm_lane_count) && m_lanes[chosen].empty())
+		{
+			++chosen;
+		}
+		if (chosen == sm_lane_count)
+		{
+			return false;
+		}
+
+		for (std::size_t lower = chosen + 1; lower < sm_lane_count; ++lower)
+		{
+			if (!m_lanes[lower].empty() && (++m_passed_over[lower] >= sm_aging_limit))
+			{
+				chosen = lower;
+				break;
+			}
+		}
+
+		m_passed_over[chosen] = 0;
+		pop_lane(chosen, value);
+		return true;
+	}
+
+	bool try_pop(task_priority priority, T &value)
+	{
+		const std::size_t lane = static_cast<std::size_t>(priority);
+		if (m_sizes[lane].load(std::memory_order_acquire) == 0)
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lk(m_mx);
+		if (m_lanes[lane].empty())
+		{
+			return false;
+		}
+		pop_lane(lane, value);
+		return true;
+	}
+
+	bool empty() const
+	{
+		for (auto &size : m_sizes)
+		{
+			if (size.load(std::memory_order_acquire) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::size_t size(task_priority priority) const
+	{
+		return m_sizes[static_cast<std::size_t>(priority)].load(std::memory_order_relaxed);
+	}
+
+	std::size_t size() const
+	{
+		std::size_t total = 0;
+		for (auto &size : m_sizes)
+		{
+			total += size.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+	std::chrono::steady_clock::duration oldest_wait()
+	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::duration oldest = std::chrono::steady_clock::duration::zero();
+		std::lock_guard<std::mutex> lk(m_mx);
+		for (auto &lane : m_lanes)
+		{
+			if (!lane.empty() && (now - lane.front().m_enqueued > oldest))
+			{
+				oldest = now - lane.front().m_enqueued;
+			}
+		}
+		return oldest;
+	}
+
+protected:
+private:
+	struct entry
+	{
+		T m_value;
+		std::chrono::steady_clock::time_point m_enqueued;
+	};
+
+	std::queue<entry> m_lanes[sm_lane_count];
+	unsigned m_passed_over[sm_lane_count];
+	std::atomic<std::size_t> m_sizes[sm_lane_count];
+	std::mutex m_mx;
+
+	void pop_lane(std::size_t lane, T &value)
+	{
+		value = std::move(m_lanes[lane].front().m_value);
+		m_lanes[lane].pop();
+		m_sizes[lane].fetch_sub(1, std::memory_order_relaxed);
+	}
+};
+
+template <std::size_t InlineSize>
+class basic_function_wrapper
+{
+public:
+	static_assert(InlineSize >= sizeof(void*), "inline storage must be able to hold a heap pointer");
+
+	template <typename F>
+	struct is_inline
+		: std::integral_constant<bool, (sizeof(F) <= InlineSize)
+			&& (alignof(F) <= alignof(std::max_align_t))
+			&& std::is_nothrow_move_constructible<F>::value>
+	{
+
+	};
+
+	basic_function_wrapper() = default;
+
+	template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, basic_function_wrapper>::value>::type>
+	basic_function_wrapper(F &&f)
+		: m_vtable(&callable<typename std::decay<F>::type>::sm_vtable)
+	{
+		callable<typename std::decay<F>::type>::construct(&m_storage, std::forward<F>(f));
+	}
+
+	basic_function_wrapper(basic_function_wrapper &&other) noexcept
+		: m_vtable(other.m_vtable)
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->move(&other.m_storage, &m_storage);
+			other.m_vtable = nullptr;
+		}
+	}
+
+	basic_function_wrapper &operator=(basic_function_wrapper &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			if (other.m_vtable != nullptr)
+			{
+				other.m_vtable->move(&other.m_storage, &m_storage);
+				m_vtable = other.m_vtable;
+				other.m_vtable = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	~basic_function_wrapper()
+	{
+		reset();
+	}
+
+	basic_function_wrapper(const basic_function_wrapper&) = delete;
+	basic_function_wrapper &operator=(const basic_function_wrapper&) = delete;
+
+	void operator()()
+	{
+		m_vtable->call(&m_storage);
+	}
+
+private:
+	struct vtable
+	{
+		void (*call)(void *storage);
+		void (*move)(void *from, void *to);
+		void (*destroy)(void *storage);
+	};
+
+	template <typename F, bool Inline = is_inline<F>::value>
+	struct callable
+	{
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			new (storage) F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(*static_cast<F*>(storage))();
+		}
+
+		static void move(void *from, void *to)
+		{
+			F *const f = static_cast<F*>(from);
+			new (to) F(std::move(*f));
+			f->~F();
+		}
+
+		static void destroy(void *storage)
+		{
+			static_cast<F*>(storage)->~F();
+		}
+
+		static const vtable sm_vtable;
+	};
+
+	template <typename F>
+	struct callable<F, false>
+	{
+		template <typename Arg>
+		static void construct(void *storage, Arg &&f)
+		{
+			*static_cast<F**>(storage) = new F(std::forward<Arg>(f));
+		}
+
+		static void call(void *storage)
+		{
+			(**static_cast<F**>(storage))();
+		}
+
+		static void move(void *from, void *to)
+		{
+			*static_cast<F**>(to) = *static_cast<F**>(from);
+		}
+
+		static void destroy(void *storage)
+		{
+			delete *static_cast<F**>(storage);
+		}
+
+		static const vtable sm_vtable;
+	};
+
+	const vtable *m_vtable = nullptr;
+	typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type m_storage;
+
+	void reset()
+	{
+		if (m_vtable != nullptr)
+		{
+			m_vtable->destroy(&m_storage);
+			m_vtable = nullptr;
+		}
+	}
+};
+
+template <std::size_t InlineSize>
+template <typename F, bool Inline>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, Inline>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+template <std::size_t InlineSize>
+template <typename F>
+const typename basic_function_wrapper<InlineSize>::vtable basic_function_wrapper<InlineSize>::callable<F, false>::sm_vtable =
+{
+	&callable::call, &callable::move, &callable::destroy
+};
+
+using function_wrapper = basic_function_wrapper<48>;
+
+class work_stealing_queue
+{
+public:
+	work_stealing_queue() = default;
+	work_stealing_queue(const work_stealing_queue&) = delete;
+	work_stealing_queue &operator=(const work_stealing_queue&) = delete;
+
+	void push(function_wrapper data)
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		m_deuqe.push_front(std::move(data));
+	}
+
+	bool empty() const
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		return m_deuqe.empty();
+	}
+
+	std::size_t size() const
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		return m_deuqe.size();
+	}
+
+	bool try_pop(function_wrapper &value)
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		if (m_deuqe.empty())
+		{
+			return false;
+		}
+
+		value = std::move(m_deuqe.front());
+		m_deuqe.pop_front();
+		return true;
+	}
+
+	bool try_steal(function_wrapper &value)
+	{
+		std::lock_guard<std::mutex> lk(m_mutex);
+		if (m_deuqe.empty())
+		{
+			return false;
+		}
+
+		value = std::move(m_deuqe.back());
+		m_deuqe.pop_back();
+		return true;
+	}
+
+private:
+	std::deque<function_wrapper> m_deuqe;
+	mutable std::mutex m_mutex;
+};
+
+class lock_free_work_stealing_queue
+{
+public:
+	explicit lock_free_work_stealing_queue(unsigned log_capacity = 5)
+		: m_top(0), m_bottom(0), m_array(new circular_array(log_capacity))
+	{
+
+	}
+
+	~lock_free_work_stealing_queue()
+	{
+		circular_array *const array = m_array.load(std::memory_order_relaxed);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		for (std::int64_t index = m_top.load(std::memory_order_relaxed); index < bottom; ++index)
+		{
+			delete array->get(index);
+		}
+		delete array;
+	}
+
+	lock_free_work_stealing_queue(const lock_free_work_stealing_queue&) = delete;
+	lock_free_work_stealing_queue &operator=(const lock_free_work_stealing_queue&) = delete;
+
+	void push(function_wrapper data)
+	{
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		const std::int64_t top = m_top.load(std::memory_order_acquire);
+		circular_array *array = m_array.load(std::memory_order_relaxed);
+		if (bottom - top > array->size() - 1)
+		{
+			array = grow(array, bottom, top);
+		}
+
+		array->put(bottom, new function_wrapper(std::move(data)));
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	bool empty() const
+	{
+		const std::int64_t top = m_top.load(std::memory_order_acquire);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		return bottom <= top;
+	}
+
+	std::size_t size() const
+	{
+		const std::int64_t top = m_top.load(std::memory_order_acquire);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		return bottom > top ? static_cast<std::size_t>(bottom - top) : 0;
+	}
+
+	bool try_pop(function_wrapper &value)
+	{
+		const std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		circular_array *const array = m_array.load(std::memory_order_relaxed);
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t top = m_top.load(std::memory_order_relaxed);
+		if (top > bottom)
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		function_wrapper *const task = array->get(bottom);
+		if (top == bottom)
+		{
+			const bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			if (!won)
+			{
+				return false;
+			}
+		}
+
+		value = std::move(*task);
+		delete task;
+		return true;
+	}
+
+	bool try_steal(function_wrapper &value)
+	{
+		std::int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+		{
+			return false;
+		}
+
+		circular_array *const array = m_array.load(std::memory_order_acquire);
+		function_wrapper *const task = array->get(top);
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		value = std::move(*task);
+		delete task;
+		return true;
+	}
+
+private:
+	class circular_array
+	{
+	public:
+		explicit circular_array(unsigned log_capacity)
+			: m_log_capacity(log_capacity), m_slots(new std::atomic<function_wrapper*>[std::size_t(1) << log_capacity])
+		{
+
+		}
+
+		std::int64_t size() const
+		{
+			return std::int64_t(1) << m_log_capacity;
+		}
+
+		function_wrapper *get(std::int64_t index) const
+		{
+			return m_slots[index & (size() - 1)].load(std::memory_order_acquire);
+		}
+
+		void put(std::int64_t index, function_wrapper *task)
+		{
+			m_slots[index & (size() - 1)].store(task, std::memory_order_release);
+		}
+
+		circular_array *grow(std::int64_t bottom, std::int64_t top) const
+		{
+			circular_array *const new_array = new circular_array(m_log_capacity + 1);
+			for (std::int64_t index = top; index < bottom; ++index)
+			{
+				new_array->put(index, get(index));
+			}
+			return new_array;
+		}
+
+	private:
+		const unsigned m_log_capacity;
+		std::unique_ptr<std::atomic<function_wrapper*>[]> m_slots;
+	};
+
+	std::atomic<std::int64_t> m_top;
+	char m_top_pad[64 - sizeof(std::atomic<std::int64_t>)];
+	std::atomic<std::int64_t> m_bottom;
+	char m_bottom_pad[64 - sizeof(std::atomic<std::int64_t>)];
+	std::atomic<circular_array*> m_array;
+	std::vector<std::unique_ptr<circular_array>> m_retired_arrays;
+
+	circular_array *grow(circular_array *array, std::int64_t bottom, std::int64_t top)
+	{
+		circular_array *const new_array = array->grow(bottom, top);
+		m_retired_arrays.emplace_back(array);
+		m_array.store(new_array, std::memory_order_release);
+		return new_array;
+	}
+};
+
+class event_count
+{
+public:
+	event_count()
+		: m_waiters(0), m_epoch(0)
+	{
+
+	}
+
+	event_count(const event_count&) = delete;
+	event_count &operator=(const event_count&) = delete;
+
+	unsigned prepare_wait()
+	{
+		m_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_epoch.load(std::memory_order_acquire);
+	}
+
+	void cancel_wait()
+	{
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void wait(unsigned epoch)
+	{
+		{
+			std::unique_lock<std::mutex> lk(m_mutex);
+			m_cond.wait(lk, [&] { return m_epoch.load(std::memory_order_relaxed) != epoch; });
+		}
+		m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void notify_one()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_one();
+	}
+
+	void notify_all()
+	{
+		if (!has_waiters())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lk(m_mutex);
+			m_epoch.fetch_add(1, std::memory_order_release);
+		}
+		m_cond.notify_all();
+	}
+
+private:
+	std::atomic<unsigned> m_waiters;
+	std::atomic<unsigned> m_epoch;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	bool has_waiters() const
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_waiters.load(std::memory_order_relaxed) != 0;
+	}
+};
+
+class task_state_allocator
+{
+public:
+	task_state_allocator() = default;
+	task_state_allocator(const task_state_allocator&) = delete;
+	task_state_allocator &operator=(const task_state_allocator&) = delete;
+
+	~task_state_allocator()
+	{
+		for (std::size_t index = 0; index < sm_size_classes; ++index)
+		{
+			while (m_free_blocks[index] != nullptr)
+			{
+				free_block *const block = m_free_blocks[index];
+				m_free_blocks[index] = block->m_next;
+				::operator delete(block);
+			}
+		}
+	}
+
+	static std::size_t block_size(std::size_t size)
+	{
+		return (size + sm_block_granularity - 1) / sm_block_granularity * sm_block_granularity;
+	}
+
+	void *allocate(std::size_t size)
+	{
+		const std::size_t size_class = block_size(size) / sm_block_granularity - 1;
+		if ((size_class < sm_size_classes) && (m_free_blocks[size_class] != nullptr))
+		{
+			free_block *const block = m_free_blocks[size_class];
+			m_free_blocks[size_class] = block->m_next;
+			--m_free_counts[size_class];
+			return block;
+		}
+
+		return ::operator new(block_size(size));
+	}
+
+	void deallocate(void *memory, std::size_t size)
+	{
+		const std::size_t size_class = block_size(size) / sm_block_granularity - 1;
+		if ((size_class < sm_size_classes) && (m_free_counts[size_class] < sm_max_cached_blocks))
+		{
+			free_block *const block = static_cast<free_block*>(memory);
+			block->m_next = m_free_blocks[size_class];
+			m_free_blocks[size_class] = block;
+			++m_free_counts[size_class];
+			return;
+		}
+
+		::operator delete(memory);
+	}
+
+private:
+	static const std::size_t sm_block_granularity = 64;
+	static const std::size_t sm_size_classes = 8;
+	static const std::size_t sm_max_cached_blocks = 256;
+
+	struct free_block
+	{
+		free_block *m_next;
+	};
+
+	free_block *m_free_blocks[sm_size_classes] = {};
+	std::size_t m_free_counts[sm_size_classes] = {};
+};
+
+thread_local task_state_allocator *this_thread_task_state_allocator = nullptr;
+
+void *allocate_task_state(std::size_t size)
+{
+	if (this_thread_task_state_allocator != nullptr)
+	{
+		return this_thread_task_state_allocator->allocate(size);
+	}
+
+	return ::operator new(task_state_allocator::block_size(size));
+}
+
+void deallocate_task_state(void *memory, std::size_t size)
+{
+	if (this_thread_task_state_allocator != nullptr)
+	{
+		this_thread_task_state_allocator->deallocate(memory, size);
+	}
+	else
+	{
+		::operator delete(memory);
+	}
+}
+
+const std::size_t task_completion_stripes = 64;
+
+event_count &task_completion_event(const void *key)
+{
+	static event_count completions[task_completion_stripes];
+	return completions[(reinterpret_cast<std::uintptr_t>(key) >> 6) % task_completion_stripes];
+}
+
+event_count &any_task_completion_event()
+{
+	static event_count completion;
+	return completion;
+}
+
+void notify_task_completion(const void *key)
+{
+	task_completion_event(key).notify_all();
+	any_task_completion_event().notify_all();
+}
+
+class pool_shutdown_error : public std::runtime_error
+{
+public:
+	pool_shutdown_error()
+		: std::runtime_error("thread pool has been shut down")
+	{
+
+	}
+};
+
+thread_local std::exception_ptr this_thread_drop_reason;
+
+class task_cancelled : public std::runtime_error
+{
+public:
+	task_cancelled()
+		: std::runtime_error("task was cancelled")
+	{
+
+	}
+};
+
+class task_scheduler
+{
+public:
+	virtual ~task_scheduler() = default;
+	virtual void schedule(function_wrapper task) = 0;
+};
+
+class task_continuation
+{
+public:
+	task_continuation(function_wrapper task, task_scheduler *scheduler)
+		: m_task(std::move(task)), m_scheduler(scheduler)
+	{
+
+	}
+
+	void fire()
+	{
+		if (m_scheduler != nullptr)
+		{
+			m_scheduler->schedule(std::move(m_task));
+		}
+		else
+		{
+			m_task();
+		}
+		delete this;
+	}
+
+	static void fire_all(task_continuation *head)
+	{
+		task_continuation *ordered = nullptr;
+		while (head != nullptr)
+		{
+			task_continuation *const next = head->m_next;
+			head->m_next = ordered;
+			ordered = head;
+			head = next;
+		}
+
+		while (ordered != nullptr)
+		{
+			task_continuation *const next = ordered->m_next;
+			ordered->fire();
+			ordered = next;
+		}
+	}
+
+	static task_continuation *fired()
+	{
+		static task_continuation sentinel(function_wrapper(), nullptr);
+		return &sentinel;
+	}
+
+	void link(task_continuation *next)
+	{
+		m_next = next;
+	}
+
+private:
+	function_wrapper m_task;
+	task_scheduler *m_scheduler;
+	task_continuation *m_next = nullptr;
+};
+
+struct void_result
+{
+
+};
+
+template <typename T>
+class task_state
+{
+public:
+	using value_type = typename std::conditional<std::is_void<T>::value, void_result, T>::type;
+
+	static task_state *create(task_scheduler *scheduler)
+	{
+		return new (allocate_task_state(sizeof(task_state))) task_state(scheduler);
+	}
+
+	task_scheduler *scheduler() const
+	{
+		return m_scheduler;
+	}
+
+	void add_future_reference()
+	{
+		m_refs.store(2, std::memory_order_relaxed);
+	}
+
+	bool is_ready() const
+	{
+		return m_ready.load(std::memory_order_acquire);
+	}
+
+	void wait() const
+	{
+		event_count &completion = waiter_event();
+		while (!is_ready())
+		{
+			const unsigned epoch = completion.prepare_wait();
+			if (is_ready())
+			{
+				completion.cancel_wait();
+				return;
+			}
+
+			completion.wait(epoch);
+		}
+	}
+
+	template <typename... Args>
+	void set_value(Args&&... args)
+	{
+		new (&m_storage) value_type(std::forward<Args>(args)...);
+		m_has_value = true;
+		mark_ready();
+	}
+
+	void set_exception(std::exception_ptr exception)
+	{
+		m_exception = exception;
+		mark_ready();
+	}
+
+	value_type &value()
+	{
+		if (m_exception)
+		{
+			std::rethrow_exception(m_exception);
+		}
+
+		return *reinterpret_cast<value_type*>(&m_storage);
+	}
+
+	event_count &waiter_event() const
+	{
+		m_has_waiters.store(true, std::memory_order_relaxed);
+		return task_completion_event(this);
+	}
+
+	void set_continuation(task_continuation *continuation)
+	{
+		task_continuation *head = m_continuation.load(std::memory_order_acquire);
+		do
+		{
+			if (head == task_continuation::fired())
+			{
+				continuation->fire();
+				return;
+			}
+
+			continuation->link(head);
+		}
+		while (!m_continuation.compare_exchange_weak(head, continuation, std::memory_order_acq_rel, std::memory_order_acquire));
+	}
+
+	void release()
+	{
+		if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			this->~task_state();
+			deallocate_task_state(this, sizeof(task_state));
+		}
+	}
+
+private:
+	std::atomic<bool> m_ready;
+	mutable std::atomic<bool> m_has_waiters;
+	std::atomic<int> m_refs;
+	std::atomic<task_continuation*> m_continuation;
+	task_scheduler *const m_scheduler;
+	bool m_has_value = false;
+	std::exception_ptr m_exception;
+	typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type m_storage;
+
+	explicit task_state(task_scheduler *scheduler)
+		: m_ready(false), m_has_waiters(false), m_refs(1), m_continuation(nullptr), m_scheduler(scheduler)
+	{
+
+	}
+
+	~task_state()
+	{
+		if (m_has_value)
+		{
+			reinterpret_cast<value_type*>(&m_storage)->~value_type();
+		}
+	}
+
+	void mark_ready()
+	{
+		m_ready.store(true, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_has_waiters.load(std::memory_order_relaxed))
+		{
+			task_completion_event(this).notify_all();
+		}
+
+		any_task_completion_event().notify_all();
+		task_continuation::fire_all(m_continuation.exchange(task_continuation::fired(), std::memory_order_acq_rel));
+	}
+};
+
+struct task_state_releaser
+{
+	template <typename State>
+	void operator()(State *state) const
+	{
+		state->release();
+	}
+};
+
+template <typename F>
+class pooled_task;
+
+template <typename F>
+pooled_task<F> make_pooled_task(F f, task_scheduler *scheduler = nullptr);
+
+template <typename T>
+class task_future;
+
+template <typename T>
+task_future<std::vector<task_future<T>>> when_all(std::vector<task_future<T>> futures);
+
+template <typename T>
+struct when_any_result
+{
+	std::size_t m_index;
+	std::vector<task_future<T>> m_futures;
+};
+
+template <typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures);
+
+template <typename T>
+class task_future
+{
+public:
+	task_future() = default;
+
+	task_future(task_future &&other) noexcept
+		: m_state(other.m_state)
+	{
+		other.m_state = nullptr;
+	}
+
+	task_future &operator=(task_future &&other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_state = other.m_state;
+			other.m_state = nullptr;
+		}
+		return *this;
+	}
+
+	~task_future()
+	{
+		reset();
+	}
+
+	task_future(const task_future&) = delete;
+	task_future &operator=(const task_future&) = delete;
+
+	bool valid() const
+	{
+		return m_state != nullptr;
+	}
+
+	bool is_ready() const
+	{
+		return m_state->is_ready();
+	}
+
+	void wait() const
+	{
+		m_state->wait();
+	}
+
+	event_count &completion_event() const
+	{
+		return m_state->waiter_event();
+	}
+
+	T get()
+	{
+		m_state->wait();
+		std::unique_ptr<task_state<T>, task_state_releaser> state(m_state);
+		m_state = nullptr;
+		return take(*state);
+	}
+
+	template <typename F>
+	task_future<std::invoke_result_t<F, task_future<T>>> then(F fn)
+	{
+		task_state<T> *const state = m_state;
+		task_scheduler *const scheduler = state->scheduler();
+		auto task = make_pooled_task([fn = std::move(fn), future = std::move(*this)]() mutable
+		{
+			return fn(std::move(future));
+		}, scheduler);
+		auto res = task.get_future();
+		state->set_continuation(new task_continuation(std::move(task), scheduler));
+		return res;
+	}
+
+	std::future<T> to_std_future()
+	{
+		std::shared_ptr<std::promise<T>> promise = std::make_shared<std::promise<T>>();
+		std::future<T> res = promise->get_future();
+		task_state<T> *const state = m_state;
+		state->set_continuation(new task_continuation([promise, future = std::move(*this)]() mutable
+		{
+			try
+			{
+				fulfil(*promise, future);
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+			}
+		}, nullptr));
+		return res;
+	}
+
+private:
+	template <typename F>
+	friend class pooled_task;
+	template <typename U>
+	friend task_future<std::vector<task_future<U>>> when_all(std::vector<task_future<U>> futures);
+	template <typename U>
+	friend task_future<when_any_result<U>> when_any(std::vector<task_future<U>> futures);
+
+	task_state<T> *m_state = nullptr;
+
+	explicit task_future(task_state<T> *state)
+		: m_state(state)
+	{
+
+	}
+
+	template <typename U>
+	static U take(task_state<U> &state)
+	{
+		return std::move(state.value());
+	}
+
+	static void take(task_state<void> &state)
+	{
+		state.value();
+	}
+
+	template <typename U>
+	static void fulfil(std::promise<U> &promise, task_future<U> &future)
+	{
+		promise.set_value(future.get());
+	}
+
+	static void fulfil(std::promise<void> &promise, task_future<void> &future)
+	{
+		future.get();
+		promise.set_value();
+	}
+
+	void reset()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->release();
+			m_state = nullptr;
+		}
+	}
+};
+
+template <typename F>
+class pooled_task
+{
+public:
+	using result_type = std::invoke_result_t<F>;
+
+	explicit pooled_task(F f, task_scheduler *scheduler = nullptr)
+		: m_f(std::move(f)), m_state(task_state<result_type>::create(scheduler))
+	{
+
+	}
+
+	pooled_task(pooled_task &&other) noexcept(std::is_nothrow_move_constructible<F>::value)
+		: m_f(std::move(other.m_f)), m_state(other.m_state)
+	{
+		other.m_state = nullptr;
+	}
+
+	~pooled_task()
+	{
+		if (m_state != nullptr)
+		{
+			m_state->set_exception((this_thread_drop_reason != nullptr) ? this_thread_drop_reason
+				: std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+			m_state->release();
+		}
+	}
+
+	pooled_task(const pooled_task&) = delete;
+	pooled_task &operator=(const pooled_task&) = delete;
+	pooled_task &operator=(pooled_task&&) = delete;
+
+	task_future<result_type> get_future()
+	{
+		m_state->add_future_reference();
+		return task_future<result_type>(m_state);
+	}
+
+	void operator()()
+	{
+		run(std::is_void<result_type>());
+		m_state->release();
+		m_state = nullptr;
+	}
+
+private:
+	F m_f;
+	task_state<result_type> *m_state;
+
+	void run(std::false_type)
+	{
+		try
+		{
+			m_state->set_value(m_f());
+		}
+		catch (...)
+		{
+			m_state->set_exception(std::current_exception());
+		}
+	}
+
+	void run(std::true_type)
+	{
+		try
+		{
+			m_f();
+			m_state->set_value();
+		}
+		catch (...)
+		{
+			m_state->set_exception(std::current_exception());
+		}
+	}
+};
+
+template <typename F>
+pooled_task<F> make_pooled_task(F f, task_scheduler *scheduler)
+{
+	return pooled_task<F>(std::move(f), scheduler);
+}
+
+template <typename T>
+task_future<std::vector<task_future<T>>> when_all(std::vector<task_future<T>> futures)
+{
+	struct when_all_state
+	{
+		std::vector<task_future<T>> m_futures;
+		std::atomic<std::size_t> m_remaining;
+		function_wrapper m_complete;
+	};
+
+	std::shared_ptr<when_all_state> shared = std::make_shared<when_all_state>();
+	when_all_state *const raw = shared.get();
+	task_scheduler *const scheduler = futures.empty() ? nullptr : futures.front().m_state->scheduler();
+	auto complete = make_pooled_task([raw] { return std::move(raw->m_futures); }, scheduler);
+	task_future<std::vector<task_future<T>>> res = complete.get_future();
+	shared->m_complete = std::move(complete);
+	shared->m_remaining.store(futures.size(), std::memory_order_relaxed);
+	std::vector<task_state<T>*> states;
+	states.reserve(futures.size());
+	for (auto &future : futures)
+	{
+		states.push_back(future.m_state);
+	}
+	shared->m_futures = std::move(futures);
+
+	if (states.empty())
+	{
+		shared->m_complete();
+		return res;
+	}
+
+	for (auto *state : states)
+	{
+		state->set_continuation(new task_continuation([shared]
+		{
+			if (shared->m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				shared->m_complete();
+			}
+		}, nullptr));
+	}
+
+	return res;
+}
+
+template <typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures)
+{
+	struct when_any_state
+	{
+		when_any_result<T> m_result;
+		std::atomic<bool> m_fired{ false };
+		std::atomic<int> m_gate{ 2 };
+		function_wrapper m_complete;
+
+		void arrive()
+		{
+			if (m_gate.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				m_complete();
+			}
+		}
+	};
+
+	std::shared_ptr<when_any_state> shared = std::make_shared<when_any_state>();
+	when_any_state *const raw = shared.get();
+	task_scheduler *const scheduler = futures.empty() ? nullptr : futures.front().m_state->scheduler();
+	auto complete = make_pooled_task([raw] { return std::move(raw->m_result); }, scheduler);
+	task_future<when_any_result<T>> res = complete.get_future();
+	shared->m_complete = std::move(complete);
+	std::vector<task_state<T>*> states;
+	states.reserve(futures.size());
+	for (auto &future : futures)
+	{
+		states.push_back(future.m_state);
+	}
+	shared->m_result.m_index = futures.size();
+	shared->m_result.m_futures = std::move(futures);
+
+	if (states.empty())
+	{
+		shared->m_complete();
+		return res;
+	}
+
+	for (std::size_t index = 0; index < states.size(); ++index)
+	{
+		states[index]->set_continuation(new task_continuation([shared, index]
+		{
+			if (!shared->m_fired.exchange(true, std::memory_order_acq_rel))
+			{
+				shared->m_result.m_index = index;
+				shared->arrive();
+			}
+		}, nullptr));
+	}
+	shared->arrive();
+
+	return res;
+}
+
+enum class victim_selection
+{
+	round_robin,
+	random
+};
+
+struct steal_policy
+{
+	victim_selection m_victims = victim_selection::random;
+	bool m_steal_half = true;
+	unsigned m_max_failed_rounds = 64;
+};
+
+struct steal_statistics
+{
+	std::uint64_t m_attempts = 0;
+	std::uint64_t m_successes = 0;
+	std::uint64_t m_tasks_stolen = 0;
+	std::uint64_t m_failed_rounds = 0;
+	std::uint64_t m_parks = 0;
+};
+
+struct worker_statistics
+{
+	std::uint64_t m_tasks_run = 0;
+	std::uint64_t m_local_tasks = 0;
+	std::uint64_t m_pool_tasks = 0;
+	std::uint64_t m_stolen_tasks = 0;
+	std::uint64_t m_steal_attempts = 0;
+	std::uint64_t m_parks = 0;
+	std::uint64_t m_idle_ns = 0;
+	std::size_t m_queue_depth = 0;
+};
+
+struct pool_statistics
+{
+	std::vector<worker_statistics> m_workers;
+	worker_statistics m_external;
+	std::size_t m_pool_queue_depth = 0;
+};
+
+std::ostream &write_json(std::ostream &out, const worker_statistics &stats)
+{
+	return out << "{\"tasks_run\":" << stats.m_tasks_run
+		<< ",\"local_tasks\":" << stats.m_local_tasks
+		<< ",\"pool_tasks\":" << stats.m_pool_tasks
+		<< ",\"stolen_tasks\":" << stats.m_stolen_tasks
+		<< ",\"steal_attempts\":" << stats.m_steal_attempts
+		<< ",\"parks\":" << stats.m_parks
+		<< ",\"idle_ns\":" << stats.m_idle_ns
+		<< ",\"queue_depth\":" << stats.m_queue_depth << "}";
+}
+
+std::ostream &write_json(std::ostream &out, const pool_statistics &stats)
+{
+	out << "{\"pool_queue_depth\":" << stats.m_pool_queue_depth << ",\"workers\":[";
+	for (std::size_t index = 0; index < stats.m_workers.size(); ++index)
+	{
+		if (index != 0)
+		{
+			out << ",";
+		}
+		write_json(out, stats.m_workers[index]);
+	}
+	out << "],\"external\":";
+	write_json(out, stats.m_external);
+	return out << "}";
+}
+
+struct thread_pool_options
+{
+	unsigned m_thread_count = 0;
+	std::vector<unsigned> m_cpus;
+	bool m_pin_threads = false;
+	bool m_numa_aware_stealing = false;
+	steal_policy m_steal_policy;
+	unsigned m_max_threads = 0;
+	std::size_t m_spawn_queue_depth = 64;
+	std::chrono::milliseconds m_spawn_wait = std::chrono::milliseconds(10);
+	std::chrono::milliseconds m_idle_retire = std::chrono::milliseconds(500);
+};
+
+std::vector<unsigned> parse_cpu_list(const std::string &list)
+{
+	std::vector<unsigned> cpus;
+	std::istringstream input(list);
+	std::string range;
+	while (std::getline(input, range, ','))
+	{
+		range.erase(std::remove_if(range.begin(), range.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; }), range.end());
+		if (range.empty())
+		{
+			continue;
+		}
+
+		const std::size_t dash = range.find('-');
+		std::size_t first_end = 0;
+		std::size_t last_end = 0;
+		try
+		{
+			const unsigned long first = std::stoul(range.substr(0, dash), &first_end);
+			const unsigned long last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1), &last_end);
+			if ((first_end != range.substr(0, dash).size())
+				|| ((dash != std::string::npos) && (last_end != range.size() - dash - 1))
+				|| (last < first))
+			{
+				throw std::invalid_argument(range);
+			}
+
+			for (unsigned long cpu = first; cpu <= last; ++cpu)
+			{
+				cpus.push_back(static_cast<unsigned>(cpu));
+			}
+		}
+		catch (const std::logic_error&)
+		{
+			throw std::invalid_argument("invalid cpu list: " + list);
+		}
+	}
+
+	return cpus;
+}
+
+std::vector<unsigned> allowed_cpus()
+{
+	std::vector<unsigned> cpus;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (CPU_ISSET(cpu, &set))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}
+#endif
+	for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+	{
+		cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+unsigned container_cpu_quota()
+{
+	long long quota = -1;
+	long long period = 0;
+	std::ifstream cpu_max("/sys/fs/cgroup/cpu.max");
+	std::string quota_text;
+	if (cpu_max >> quota_text >> period)
+	{
+		if (quota_text != "max")
+		{
+			quota = std::stoll(quota_text);
+		}
+	}
+	else
+	{
+		std::ifstream cfs_quota("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+		std::ifstream cfs_period("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+		if (!(cfs_quota >> quota) || !(cfs_period >> period))
+		{
+			quota = -1;
+		}
+	}
+
+	if ((quota <= 0) || (period <= 0))
+	{
+		return 0;
+	}
+
+	return static_cast<unsigned>((quota + period - 1) / period);
+}
+
+unsigned default_thread_count()
+{
+	unsigned count = static_cast<unsigned>(allowed_cpus().size());
+	const unsigned quota = container_cpu_quota();
+	if ((quota != 0) && (quota < count))
+	{
+		count = quota;
+	}
+
+	return count != 0 ? count : 1;
+}
+
+std::vector<int> cpu_numa_nodes()
+{
+	std::vector<int> nodes;
+	std::ifstream online("/sys/devices/system/node/online");
+	std::string node_list;
+	if (!std::getline(online, node_list))
+	{
+		return nodes;
+	}
+
+	for (unsigned node : parse_cpu_list(node_list))
+	{
+		std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		std::string cpu_list;
+		if (!std::getline(cpulist, cpu_list))
+		{
+			continue;
+		}
+
+		for (unsigned cpu : parse_cpu_list(cpu_list))
+		{
+			if (cpu >= nodes.size())
+			{
+				nodes.resize(cpu + 1, -1);
+			}
+			nodes[cpu] = static_cast<int>(node);
+		}
+	}
+
+	return nodes;
+}
+
+bool pin_this_thread_to_cpu(unsigned cpu)
+{
+#if defined(__linux__)
+	if (cpu >= CPU_SETSIZE)
+	{
+		return false;
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+	return (cpu < sizeof(DWORD_PTR) * 8) && (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0);
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+struct timer_entry
+{
+	enum state
+	{
+		pending,
+		fired,
+		cancelled
+	};
+
+	timer_entry(function_wrapper fn, std::uint64_t deadline, std::uint64_t period)
+		: m_fn(std::move(fn)), m_deadline(deadline), m_period(period), m_state(pending)
+	{
+
+	}
+
+	function_wrapper m_fn;
+	std::uint64_t m_deadline;
+	const std::uint64_t m_period;
+	std::atomic<int> m_state;
+};
+
+class timer_handle
+{
+public:
+	timer_handle() = default;
+
+	explicit timer_handle(std::shared_ptr<timer_entry> entry)
+		: m_entry(std::move(entry))
+	{
+
+	}
+
+	bool valid() const
+	{
+		return m_entry != nullptr;
+	}
+
+	bool cancel()
+	{
+		if (m_entry == nullptr)
+		{
+			return false;
+		}
+
+		int expected = timer_entry::pending;
+		if (!m_entry->m_state.compare_exchange_strong(expected, timer_entry::cancelled, std::memory_order_acq_rel))
+		{
+			return false;
+		}
+
+		if (m_entry->m_period == 0)
+		{
+			this_thread_drop_reason = std::make_exception_ptr(task_cancelled());
+			m_entry->m_fn = function_wrapper();
+			this_thread_drop_reason = nullptr;
+		}
+		return true;
+	}
+
+private:
+	std::shared_ptr<timer_entry> m_entry;
+};
+
+template <typename T>
+struct scheduled_task
+{
+	task_future<T> m_future;
+	timer_handle m_handle;
+};
+
+class timer_wheel
+{
+public:
+	static const unsigned sm_slot_bits = 6;
+	static const std::size_t sm_slot_count = std::size_t(1) << sm_slot_bits;
+	static const std::size_t sm_level_count = 4;
+
+	explicit timer_wheel(std::chrono::steady_clock::duration tick = std::chrono::milliseconds(1))
+		: m_tick(tick), m_start(std::chrono::steady_clock::now()), m_current(0), m_size(0)
+	{
+
+	}
+
+	std::uint64_t deadline_tick(std::chrono::steady_clock::time_point when) const
+	{
+		if (when <= m_start)
+		{
+			return 0;
+		}
+		return static_cast<std::uint64_t>((when - m_start + m_tick - std::chrono::steady_clock::duration(1)) / m_tick);
+	}
+
+	std::uint64_t period_ticks(std::chrono::steady_clock::duration period) const
+	{
+		return std::max<std::uint64_t>(1, static_cast<std::uint64_t>((period + m_tick - std::chrono::steady_clock::duration(1)) / m_tick));
+	}
+
+	std::uint64_t now_tick() const
+	{
+		return static_cast<std::uint64_t>((std::chrono::steady_clock::now() - m_start) / m_tick);
+	}
+
+	std::chrono::steady_clock::time_point tick_time(std::uint64_t tick) const
+	{
+		return m_start + m_tick * static_cast<std::chrono::steady_clock::rep>(tick);
+	}
+
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	void insert(std::shared_ptr<timer_entry> entry)
+	{
+		++m_size;
+		place(std::move(entry));
+	}
+
+	void advance(std::uint64_t now, std::vector<std::shared_ptr<timer_entry>> &expired)
+	{
+		if (m_size == 0)
+		{
+			m_current = std::max(m_current, now);
+			return;
+		}
+
+		while (m_current < now)
+		{
+			++m_current;
+			for (std::size_t level = sm_level_count - 1; level > 0; --level)
+			{
+				if ((m_current & ((std::uint64_t(1) << (sm_slot_bits * level)) - 1)) == 0)
+				{
+					cascade(level, (m_current >> (sm_slot_bits * level)) & (sm_slot_count - 1));
+				}
+			}
+
+			std::vector<std::shared_ptr<timer_entry>> &slot = m_slots[0][m_current & (sm_slot_count - 1)];
+			m_size -= slot.size();
+			for (auto &entry : slot)
+			{
+				if (entry->m_state.load(std::memory_order_acquire) == timer_entry::pending)
+				{
+					expired.push_back(std::move(entry));
+				}
+			}
+			slot.clear();
+		}
+	}
+
+	void clear(std::vector<std::shared_ptr<timer_entry>> &entries)
+	{
+		for (auto &level : m_slots)
+		{
+			for (auto &slot : level)
+			{
+				for (auto &entry : slot)
+				{
+					entries.push_back(std::move(entry));
+				}
+				slot.clear();
+			}
+		}
+		m_size = 0;
+	}
+
+	std::uint64_t next_expiry() const
+	{
+		for (std::uint64_t tick = m_current + 1; tick <= m_current + sm_slot_count; ++tick)
+		{
+			if (!m_slots[0][tick & (sm_slot_count - 1)].empty())
+			{
+				return tick;
+			}
+		}
+		return ((m_current >> sm_slot_bits) + 1) << sm_slot_bits;
+	}
+
+private:
+	const std::chrono::steady_clock::duration m_tick;
+	const std::chrono::steady_clock::time_point m_start;
+	std::uint64_t m_current;
+	std::size_t m_size;
+	std::vector<std::shared_ptr<timer_entry>> m_slots[sm_level_count][sm_slot_count];
+
+	void place(std::shared_ptr<timer_entry> entry)
+	{
+		const std::uint64_t deadline = std::max(entry->m_deadline, m_current + 1);
+		const std::uint64_t delta = deadline - m_current;
+		std::size_t level = 0;
+		while ((level + 1 < sm_level_count) && (delta >= (std::uint64_t(1) << (sm_slot_bits * (level + 1)))))
+		{
+			++level;
+		}
+
+		m_slots[level][(deadline >> (sm_slot_bits * level)) & (sm_slot_count - 1)].push_back(std::move(entry));
+	}
+
+	void cascade(std::size_t level, std::uint64_t index)
+	{
+		std::vector<std::shared_ptr<timer_entry>> entries;
+		entries.swap(m_slots[level][index]);
+		for (auto &entry : entries)
+		{
+			if (entry->m_state.load(std::memory_order_acquire) == timer_entry::pending)
+			{
+				place(std::move(entry));
+			}
+			else
+			{
+				--m_size;
+			}
+		}
+	}
+};
+
+enum class shutdown_mode
+{
+	drain,
+	abort
+};
+
+struct shutdown_result
+{
+	std::size_t m_tasks_run = 0;
+	std::size_t m_tasks_dropped = 0;
+	bool m_timed_out = false;
+};
+
+template <typename ThreadPool>
+class schedule_awaiter
+{
+public:
+	explicit schedule_awaiter(ThreadPool &pool)
+		: m_pool(pool)
+	{
+
+	}
+
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		m_pool.schedule(function_wrapper([handle] { handle.resume(); }));
+	}
+
+	void await_resume() const noexcept
+	{
+
+	}
+
+private:
+	ThreadPool &m_pool;
+};
+
+template <typename ThreadPool>
+class task_group;
+
+template <typename WorkStealingQueue = lock_free_work_stealing_queue>
+class thread_pool : public task_scheduler
+{
+public:
+	thread_pool()
+		: thread_pool(thread_pool_options())
+	{
+
+	}
+
+	explicit thread_pool(steal_policy policy)
+		: thread_pool(options_with_policy(policy))
+	{
+
+	}
+
+	explicit thread_pool(thread_pool_options options)
+		: m_done(false), m_policy(options.m_steal_policy), m_active_threads(0), m_elastic(options.m_max_threads != 0),
+		m_spawn_queue_depth(options.m_spawn_queue_depth), m_spawn_wait(options.m_spawn_wait), m_idle_retire(options.m_idle_retire),
+		m_joiner(m_threads)
+	{
+		if (options.m_pin_threads && options.m_cpus.empty())
+		{
+			options.m_cpus = allowed_cpus();
+		}
+		const unsigned thread_count = (options.m_thread_count != 0) ? options.m_thread_count
+			: !options.m_cpus.empty() ? static_cast<unsigned>(options.m_cpus.size())
+			: default_thread_count();
+		const unsigned slot_count = std::max(thread_count, options.m_max_threads);
+		m_worker_cpus.assign(slot_count, -1);
+		if (options.m_pin_threads)
+		{
+			for (unsigned index = 0; index < slot_count; ++index)
+			{
+				m_worker_cpus[index] = static_cast<int>(options.m_cpus[index % options.m_cpus.size()]);
+			}
+		}
+		if (options.m_numa_aware_stealing)
+		{
+			build_victim_order(m_worker_cpus);
+		}
+
+		try
+		{
+			m_counters.reset(new worker_counters[slot_count + 1]);
+			m_slots.reset(new worker_slot[slot_count]);
+			for (unsigned index = 0; index < slot_count; ++index)
+			{
+				m_queues.push_back(std::make_unique<WorkStealingQueue>());
+			}
+			m_threads.resize(slot_count);
+			for (unsigned index = 0; index < thread_count; ++index)
+			{
+				start_worker(index);
+			}
+			m_min_threads = thread_count;
+			if (m_elastic)
+			{
+				m_supervisor = std::thread(&thread_pool::supervise, this);
+			}
+		}
+		catch (...)
+		{
+			m_done = true;
+			m_work_event.notify_all();
+			throw;
+		}
+	}
+
+	~thread_pool()
+	{
+		shutdown(shutdown_mode::abort);
+	}
+
+	shutdown_result shutdown(shutdown_mode mode, std::chrono::steady_clock::duration timeout = std::chrono::steady_clock::duration::max())
+	{
+		std::lock_guard<std::mutex> lk(m_shutdown_mx);
+		shutdown_result result;
+		if (m_stopped)
+		{
+			return result;
+		}
+
+		const std::uint64_t tasks_run_before = tasks_run_so_far();
+		if (mode == shutdown_mode::drain)
+		{
+			m_draining = true;
+			m_work_event.notify_all();
+			result.m_timed_out = !wait_for_workers(timeout);
+		}
+
+		m_done = true;
+		m_work_event.notify_all();
+		if (m_supervisor.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> supervisor_lk(m_supervisor_mx);
+			}
+			m_supervisor_cv.notify_all();
+			m_supervisor.join();
+		}
+		if (m_timer_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> timer_lk(m_timer_mx);
+			}
+			m_timer_cv.notify_all();
+			m_timer_thread.join();
+		}
+		for (auto &t : m_threads)
+		{
+			if (t.joinable())
+			{
+				t.join();
+			}
+		}
+		m_stopped = true;
+
+		result.m_tasks_run = static_cast<std::size_t>(tasks_run_so_far() - tasks_run_before);
+		result.m_tasks_dropped = drop_pending_tasks();
+		return result;
+	}
+
+	template <typename FunctionType>
+	task_future<std::invoke_result_t<FunctionType>> submit(FunctionType f)
+	{
+		return submit(task_priority::normal, std::move(f));
+	}
+
+	template <typename FunctionType>
+	task_future<std::invoke_result_t<FunctionType>> submit(task_priority priority, FunctionType f)
+	{
+		using result_type = std::invoke_result_t<FunctionType>;
+		if (m_done && (sm_local_work_queue == nullptr))
+		{
+			throw pool_shutdown_error();
+		}
+
+		pooled_task<FunctionType> task(std::move(f), this);
+		task_future<result_type> res(task.get_future());
+		if ((priority == task_priority::normal) && (sm_local_work_queue != nullptr))
+		{
+			sm_local_work_queue->push(std::move(task));
+		}
+		else
+		{
+			m_pool_work_queue.push(priority, std::move(task));
+		}
+		m_work_event.notify_one();
+		
+		return res;
+	}
+
+	template <typename Iterator>
+	std::vector<task_future<std::invoke_result_t<typename std::iterator_traits<Iterator>::value_type>>> submit_batch(Iterator first, Iterator last)
+	{
+		using result_type = std::invoke_result_t<typename std::iterator_traits<Iterator>::value_type>;
+		std::vector<function_wrapper> tasks;
+		std::vector<task_future<result_type>> res;
+		for (; first != last; ++first)
+		{
+			auto task = make_pooled_task(std::move(*first), this);
+			res.push_back(task.get_future());
+			tasks.push_back(std::move(task));
+		}
+
+		push_batch(tasks);
+		return res;
+	}
+
+	template <typename FunctionType>
+	std::vector<task_future<std::invoke_result_t<FunctionType, std::size_t>>> submit_n(std::size_t count, FunctionType index_fn)
+	{
+		using result_type = std::invoke_result_t<FunctionType, std::size_t>;
+		std::vector<function_wrapper> tasks;
+		std::vector<task_future<result_type>> res;
+		tasks.reserve(count);
+		res.reserve(count);
+		for (std::size_t index = 0; index < count; ++index)
+		{
+			auto task = make_pooled_task(std::bind(index_fn, index), this);
+			res.push_back(task.get_future());
+			tasks.push_back(std::move(task));
+		}
+
+		push_batch(tasks);
+		return res;
+	}
+
+	void schedule(function_wrapper task) override
+	{
+		if (m_done && (sm_local_work_queue == nullptr))
+		{
+			task();
+			return;
+		}
+
+		if (sm_local_work_queue != nullptr)
+		{
+			sm_local_work_queue->push(std::move(task));
+		}
+		else
+		{
+			m_pool_work_queue.push(task_priority::normal, std::move(task));
+		}
+		m_work_event.notify_one();
+	}
+
+	schedule_awaiter<thread_pool> schedule()
+	{
+		return schedule_awaiter<thread_pool>(*this);
+	}
+
+	template <typename FunctionType>
+	scheduled_task<std::invoke_result_t<FunctionType>> submit_at(std::chrono::steady_clock::time_point when, FunctionType f)
+	{
+		using result_type = std::invoke_result_t<FunctionType>;
+		pooled_task<FunctionType> task(std::move(f), this);
+		scheduled_task<result_type> res;
+		res.m_future = task.get_future();
+		res.m_handle = add_timer(when, std::chrono::steady_clock::duration::zero(), std::move(task));
+		return res;
+	}
+
+	template <typename Rep, typename Period, typename FunctionType>
+	scheduled_task<std::invoke_result_t<FunctionType>> submit_after(std::chrono::duration<Rep, Period> delay, FunctionType f)
+	{
+		return submit_at(std::chrono::steady_clock::now() + delay, std::move(f));
+	}
+
+	template <typename Rep, typename Period, typename FunctionType>
+	timer_handle submit_every(std::chrono::duration<Rep, Period> period, FunctionType f)
+	{
+		const std::chrono::steady_clock::duration interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+		return add_timer(std::chrono::steady_clock::now() + interval, interval, std::move(f));
+	}
+
+	void run_pending_task()
+	{
+		if (!try_run_pending_task())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	template <typename Predicate>
+	void help_until(Predicate done)
+	{
+		help_until(done, any_task_completion_event());
+	}
+
+	template <typename Predicate>
+	void help_until(Predicate done, event_count &completion)
+	{
+		unsigned failed_rounds = 0;
+		while (!done())
+		{
+			if (try_run_pending_task())
+			{
+				failed_rounds = 0;
+			}
+			else if (++failed_rounds < m_policy.m_max_failed_rounds)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				failed_rounds = 0;
+				const unsigned epoch = completion.prepare_wait();
+				if (done() || has_pending_task())
+				{
+					completion.cancel_wait();
+					continue;
+				}
+
+				completion.wait(epoch);
+			}
+		}
+	}
+
+	template <typename Function, typename... Functions>
+	void parallel_invoke(Function &&first, Functions&&... rest)
+	{
+		task_group<thread_pool> group(*this);
+		int spawned[] = { 0, (group.run(std::forward<Functions>(rest)), 0)... };
+		(void)spawned;
+		first();
+		group.wait();
+	}
+
+	const steal_policy &policy() const
+	{
+		return m_policy;
+	}
+
+	std::size_t thread_count() const
+	{
+		return m_active_threads.load(std::memory_order_relaxed);
+	}
+
+	steal_statistics steal_stats() const
+	{
+		steal_statistics stats;
+		for (std::size_t index = 0; index <= m_queues.size(); ++index)
+		{
+			const worker_counters &counters = m_counters[index];
+			stats.m_attempts += counters.m_attempts.load(std::memory_order_relaxed);
+			stats.m_successes += counters.m_successes.load(std::memory_order_relaxed);
+			stats.m_tasks_stolen += counters.m_tasks_stolen.load(std::memory_order_relaxed);
+			stats.m_failed_rounds += counters.m_failed_rounds.load(std::memory_order_relaxed);
+			stats.m_parks += counters.m_parks.load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+
+	pool_statistics stats() const
+	{
+		pool_statistics stats;
+		stats.m_pool_queue_depth = m_pool_work_queue.size();
+		stats.m_workers.resize(m_queues.size());
+		for (std::size_t index = 0; index <= m_queues.size(); ++index)
+		{
+			const worker_counters &counters = m_counters[index];
+			worker_statistics &worker = (index < m_queues.size()) ? stats.m_workers[index] : stats.m_external;
+			worker.m_local_tasks = counters.m_local_tasks.load(std::memory_order_relaxed);
+			worker.m_pool_tasks = counters.m_pool_tasks.load(std::memory_order_relaxed);
+			worker.m_stolen_tasks = counters.m_successes.load(std::memory_order_relaxed);
+			worker.m_tasks_run = worker.m_local_tasks + worker.m_pool_tasks + worker.m_stolen_tasks;
+			worker.m_steal_attempts = counters.m_attempts.load(std::memory_order_relaxed);
+			worker.m_parks = counters.m_parks.load(std::memory_order_relaxed);
+			worker.m_idle_ns = counters.m_idle_ns.load(std::memory_order_relaxed);
+			if (index < m_queues.size())
+			{
+				worker.m_queue_depth = m_queues[index]->size();
+			}
+		}
+		return stats;
+	}
+
+private:
+	struct worker_counters
+	{
+		std::atomic<std::uint64_t> m_local_tasks{ 0 };
+		std::atomic<std::uint64_t> m_pool_tasks{ 0 };
+		std::atomic<std::uint64_t> m_attempts{ 0 };
+		std::atomic<std::uint64_t> m_successes{ 0 };
+		std::atomic<std::uint64_t> m_tasks_stolen{ 0 };
+		std::atomic<std::uint64_t> m_failed_rounds{ 0 };
+		std::atomic<std::uint64_t> m_parks{ 0 };
+		std::atomic<std::uint64_t> m_idle_ns{ 0 };
+		char m_pad[128 - 8 * sizeof(std::atomic<std::uint64_t>)];
+	};
+
+	enum class worker_state
+	{
+		vacant,
+		running,
+		retiring
+	};
+
+	struct worker_slot
+	{
+		std::atomic<worker_state> m_state{ worker_state::vacant };
+		std::atomic<std::chrono::steady_clock::rep> m_idle_since{ 0 };
+		char m_pad[64 - 2 * sizeof(std::atomic<std::chrono::steady_clock::rep>)];
+	};
+
+	std::atomic<bool> m_done;
+	std::atomic<bool> m_draining{ false };
+	std::mutex m_shutdown_mx;
+	bool m_stopped = false;
+	unsigned m_live_workers = 0;
+	std::mutex m_exit_mx;
+	std::condition_variable m_exit_cv;
+	const steal_policy m_policy;
+	priority_task_queue<function_wrapper> m_pool_work_queue;
+	event_count m_work_event;
+	std::vector<std::unique_ptr<WorkStealingQueue>> m_queues;
+	std::unique_ptr<worker_counters[]> m_counters;
+	std::unique_ptr<worker_slot[]> m_slots;
+	std::vector<int> m_worker_cpus;
+	std::vector<std::vector<unsigned>> m_victim_order;
+	std::vector<std::size_t> m_near_victim_count;
+	std::atomic<unsigned> m_active_threads;
+	unsigned m_min_threads = 0;
+	const bool m_elastic;
+	const std::size_t m_spawn_queue_depth;
+	const std::chrono::milliseconds m_spawn_wait;
+	const std::chrono::milliseconds m_idle_retire;
+	std::mutex m_supervisor_mx;
+	std::condition_variable m_supervisor_cv;
+	std::thread m_supervisor;
+	std::mutex m_timer_mx;
+	std::condition_variable m_timer_cv;
+	timer_wheel m_timers;
+	std::atomic<bool> m_timers_due{ false };
+	std::once_flag m_timer_thread_started;
+	std::thread m_timer_thread;
+	std::vector<std::thread> m_threads;
+	join_threads m_joiner;
+	static thread_local WorkStealingQueue* sm_local_work_queue;
+	static thread_local unsigned sm_my_index;
+	static thread_local std::minstd_rand sm_victim_random;
+	static thread_local unsigned sm_local_streak;
+
+	bool try_run_pending_task()
+	{
+		function_wrapper task;
+		worker_counters &counters = my_counters();
+		if ((sm_local_work_queue != nullptr) && m_timers_due.load(std::memory_order_relaxed))
+		{
+			service_timers();
+		}
+
+		if (pop_task_from_pool_queue(task, task_priority::high))
+		{
+			count(counters.m_pool_tasks, 1);
+		}
+		else if (pop_task_from_local_queue(task))
+		{
+			count(counters.m_local_tasks, 1);
+		}
+		else if (pop_task_from_pool_queue(task))
+		{
+			count(counters.m_pool_tasks, 1);
+		}
+		else if (!pop_task_from_other_thread_queue(task))
+		{
+			return false;
+		}
+
+		task();
+		return true;
+	}
+
+	static thread_pool_options options_with_policy(steal_policy policy)
+	{
+		thread_pool_options options;
+		options.m_steal_policy = policy;
+		return options;
+	}
+
+	void build_victim_order(const std::vector<int> &worker_cpus)
+	{
+		const std::vector<int> cpu_nodes = cpu_numa_nodes();
+		std::vector<int> worker_nodes(worker_cpus.size(), -1);
+		for (std::size_t index = 0; index < worker_cpus.size(); ++index)
+		{
+			const int cpu = worker_cpus[index];
+			if ((cpu >= 0) && (static_cast<std::size_t>(cpu) < cpu_nodes.size()))
+			{
+				worker_nodes[index] = cpu_nodes[cpu];
+			}
+		}
+
+		m_victim_order.resize(worker_cpus.size());
+		m_near_victim_count.resize(worker_cpus.size());
+		for (std::size_t thief = 0; thief < worker_cpus.size(); ++thief)
+		{
+			std::vector<unsigned> &victims = m_victim_order[thief];
+			for (unsigned pass = 0; pass < 2; ++pass)
+			{
+				for (std::size_t victim = 0; victim < worker_cpus.size(); ++victim)
+				{
+					const bool near = (worker_nodes[thief] >= 0) && (worker_nodes[victim] == worker_nodes[thief]);
+					if ((victim != thief) && (near == (pass == 0)))
+					{
+						victims.push_back(static_cast<unsigned>(victim));
+					}
+				}
+				if (pass == 0)
+				{
+					m_near_victim_count[thief] = victims.size();
+				}
+			}
+		}
+	}
+
+	void work_thread(unsigned my_index, int cpu)
+	{
+		if (cpu >= 0)
+		{
+			pin_this_thread_to_cpu(static_cast<unsigned>(cpu));
+		}
+
+		task_state_allocator state_allocator;
+		this_thread_task_state_allocator = &state_allocator;
+		sm_my_index = my_index;
+		sm_local_work_queue = m_queues[my_index].get();
+		sm_victim_random.seed(my_index + 1);
+		worker_slot &slot = m_slots[my_index];
+		bool idle = false;
+		bool searching = false;
+		std::chrono::steady_clock::time_point idle_mark;
+		unsigned failed_rounds = 0;
+		while (!m_done && (slot.m_state.load(std::memory_order_acquire) == worker_state::running))
+		{
+			if (try_run_pending_task())
+			{
+				failed_rounds = 0;
+				searching = false;
+				if (idle)
+				{
+					idle = false;
+					slot.m_idle_since.store(0, std::memory_order_relaxed);
+				}
+				continue;
+			}
+
+			if (m_draining && !has_pending_task())
+			{
+				break;
+			}
+
+			if (searching)
+			{
+				account_idle(idle_mark);
+			}
+			else
+			{
+				searching = true;
+				idle_mark = std::chrono::steady_clock::now();
+			}
+
+			count(my_counters().m_failed_rounds, 1);
+			if (++failed_rounds < m_policy.m_max_failed_rounds)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				failed_rounds = 0;
+				if (!idle)
+				{
+					idle = true;
+					slot.m_idle_since.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+				}
+				wait_for_task(slot);
+				account_idle(idle_mark);
+			}
+		}
+
+		if (!m_done)
+		{
+			migrate_local_work();
+		}
+		sm_local_work_queue = nullptr;
+		this_thread_task_state_allocator = nullptr;
+		slot.m_state.store(worker_state::vacant, std::memory_order_release);
+		worker_exited();
+	}
+
+	void start_worker(unsigned index)
+	{
+		m_slots[index].m_idle_since.store(0, std::memory_order_relaxed);
+		m_slots[index].m_state.store(worker_state::running, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lk(m_exit_mx);
+			++m_live_workers;
+		}
+		try
+		{
+			m_threads[index] = std::thread(&thread_pool::work_thread, this, index, m_worker_cpus[index]);
+		}
+		catch (...)
+		{
+			m_slots[index].m_state.store(worker_state::vacant, std::memory_order_release);
+			worker_exited();
+			throw;
+		}
+		m_active_threads.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void worker_exited()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_exit_mx);
+			--m_live_workers;
+		}
+		m_exit_cv.notify_all();
+	}
+
+	bool wait_for_workers(std::chrono::steady_clock::duration timeout)
+	{
+		std::unique_lock<std::mutex> lk(m_exit_mx);
+		if (timeout == std::chrono::steady_clock::duration::max())
+		{
+			m_exit_cv.wait(lk, [this] { return m_live_workers == 0; });
+			return true;
+		}
+		return m_exit_cv.wait_for(lk, timeout, [this] { return m_live_workers == 0; });
+	}
+
+	std::size_t drop_pending_tasks()
+	{
+		std::size_t dropped = 0;
+		this_thread_drop_reason = std::make_exception_ptr(pool_shutdown_error());
+		function_wrapper task;
+		while (m_pool_work_queue.try_pop(task))
+		{
+			task = function_wrapper();
+			++dropped;
+		}
+		for (auto &queue : m_queues)
+		{
+			while (queue->try_steal(task))
+			{
+				task = function_wrapper();
+				++dropped;
+			}
+		}
+
+		std::vector<std::shared_ptr<timer_entry>> timers;
+		m_timers.clear(timers);
+		for (auto &entry : timers)
+		{
+			int expected = timer_entry::pending;
+			if (entry->m_state.compare_exchange_strong(expected, timer_entry::cancelled, std::memory_order_acq_rel))
+			{
+				entry->m_fn = function_wrapper();
+				++dropped;
+			}
+		}
+		this_thread_drop_reason = nullptr;
+		return dropped;
+	}
+
+	std::uint64_t tasks_run_so_far() const
+	{
+		std::uint64_t total = 0;
+		for (std::size_t index = 0; index <= m_queues.size(); ++index)
+		{
+			total += m_counters[index].m_local_tasks.load(std::memory_order_relaxed)
+				+ m_counters[index].m_pool_tasks.load(std::memory_order_relaxed)
+				+ m_counters[index].m_successes.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+	void migrate_local_work()
+	{
+		std::vector<function_wrapper> tasks;
+		function_wrapper task;
+		while (sm_local_work_queue->try_pop(task))
+		{
+			tasks.push_back(std::move(task));
+		}
+
+		if (!tasks.empty())
+		{
+			m_pool_work_queue.push_range(task_priority::normal, tasks.begin(), tasks.end());
+			m_work_event.notify_all();
+		}
+	}
+
+	void supervise()
+	{
+		const std::chrono::milliseconds tick = std::max(std::chrono::milliseconds(1), std::min(m_spawn_wait, m_idle_retire) / 4);
+		std::unique_lock<std::mutex> lk(m_supervisor_mx);
+		while (!m_supervisor_cv.wait_for(lk, tick, [this] { return m_done.load(); }))
+		{
+			const unsigned active = m_active_threads.load(std::memory_order_relaxed);
+			if ((active < m_queues.size())
+				&& ((m_pool_work_queue.size() > m_spawn_queue_depth) || (m_pool_work_queue.oldest_wait() > m_spawn_wait)))
+			{
+				spawn_worker();
+			}
+			else if (active > m_min_threads)
+			{
+				retire_idle_worker();
+			}
+		}
+	}
+
+	void spawn_worker()
+	{
+		for (unsigned index = 0; index < m_queues.size(); ++index)
+		{
+			if (m_slots[index].m_state.load(std::memory_order_acquire) == worker_state::vacant)
+			{
+				if (m_threads[index].joinable())
+				{
+					m_threads[index].join();
+				}
+				start_worker(index);
+				return;
+			}
+		}
+	}
+
+	void retire_idle_worker()
+	{
+		const std::chrono::steady_clock::rep now = std::chrono::steady_clock::now().time_since_epoch().count();
+		const std::chrono::steady_clock::rep limit = std::chrono::duration_cast<std::chrono::steady_clock::duration>(m_idle_retire).count();
+		for (unsigned index = 0; index < m_queues.size(); ++index)
+		{
+			worker_slot &slot = m_slots[index];
+			const std::chrono::steady_clock::rep idle_since = slot.m_idle_since.load(std::memory_order_relaxed);
+			worker_state expected = worker_state::running;
+			if ((idle_since != 0) && (now - idle_since >= limit)
+				&& slot.m_state.compare_exchange_strong(expected, worker_state::retiring, std::memory_order_acq_rel))
+			{
+				m_active_threads.fetch_sub(1, std::memory_order_relaxed);
+				m_work_event.notify_all();
+				return;
+			}
+		}
+	}
+
+	void push_batch(std::vector<function_wrapper> &tasks)
+	{
+		if (m_done && (sm_local_work_queue == nullptr))
+		{
+			throw pool_shutdown_error();
+		}
+
+		if (tasks.empty())
+		{
+			return;
+		}
+
+		auto shared_begin = tasks.begin();
+		if (sm_local_work_queue != nullptr)
+		{
+			const std::size_t local_count = (tasks.size() + m_queues.size() - 1) / m_queues.size();
+			for (std::size_t index = 0; index < local_count; ++index, ++shared_begin)
+			{
+				sm_local_work_queue->push(std::move(*shared_begin));
+			}
+		}
+
+		m_pool_work_queue.push_range(task_priority::normal, shared_begin, tasks.end());
+		m_work_event.notify_all();
+	}
+
+	void wait_for_task(const worker_slot &slot)
+	{
+		const unsigned epoch = m_work_event.prepare_wait();
+		if (m_done || m_draining || (slot.m_state.load(std::memory_order_acquire) != worker_state::running) || has_pending_task())
+		{
+			m_work_event.cancel_wait();
+			return;
+		}
+
+		count(my_counters().m_parks, 1);
+		m_work_event.wait(epoch);
+	}
+
+	bool has_pending_task()
+	{
+		if (!m_pool_work_queue.empty() || m_timers_due.load(std::memory_order_relaxed))
+		{
+			return true;
+		}
+
+		for (auto &queue : m_queues)
+		{
+			if (!queue->empty())
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool pop_task_from_local_queue(function_wrapper &value)
+	{
+		if (sm_local_work_queue == nullptr)
+		{
+			return false;
+		}
+
+		if ((++sm_local_streak >= priority_task_queue<function_wrapper>::sm_aging_limit) && !m_pool_work_queue.empty())
+		{
+			sm_local_streak = 0;
+			return false;
+		}
+
+		return sm_local_work_queue->try_pop(value);
+	}
+
+	bool pop_task_from_pool_queue(function_wrapper &value)
+	{
+		return m_pool_work_queue.try_pop(value);
+	}
+
+	bool pop_task_from_pool_queue(function_wrapper &value, task_priority priority)
+	{
+		return m_pool_work_queue.try_pop(priority, value);
+	}
+
+	bool pop_task_from_other_thread_queue(function_wrapper &value)
+	{
+		const std::size_t queue_count = m_queues.size();
+		if (queue_count == 0)
+		{
+			return false;
+		}
+
+		const bool is_worker = (sm_local_work_queue != nullptr);
+		if (is_worker && !m_victim_order.empty())
+		{
+			const std::vector<unsigned> &victims = m_victim_order[sm_my_index];
+			const std::size_t near_count = m_near_victim_count[sm_my_index];
+			return steal_from_victims(victims.data(), near_count, value)
+				|| steal_from_victims(victims.data() + near_count, victims.size() - near_count, value);
+		}
+
+		const std::size_t first_victim = (m_policy.m_victims == victim_selection::random)
+			? sm_victim_random() % queue_count
+			: (sm_my_index + 1) % queue_count;
+		for (std::size_t index = 0; index < queue_count; ++index)
+		{
+			const std::size_t victim = (first_victim + index) % queue_count;
+			if (is_worker && (victim == sm_my_index))
+			{
+				continue;
+			}
+
+			if (try_steal_from(victim, value))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool steal_from_victims(const unsigned *victims, std::size_t victim_count, function_wrapper &value)
+	{
+		if (victim_count == 0)
+		{
+			return false;
+		}
+
+		const std::size_t first_victim = (m_policy.m_victims == victim_selection::random)
+			? sm_victim_random() % victim_count
+			: 0;
+		for (std::size_t index = 0; index < victim_count; ++index)
+		{
+			if (try_steal_from(victims[(first_victim + index) % victim_count], value))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool try_steal_from(std::size_t victim, function_wrapper &value)
+	{
+		worker_counters &counters = my_counters();
+		count(counters.m_attempts, 1);
+		if (!m_queues[victim]->try_steal(value))
+		{
+			return false;
+		}
+
+		std::uint64_t stolen = 1;
+		if ((sm_local_work_queue != nullptr) && m_policy.m_steal_half)
+		{
+			stolen += steal_half_into_local_queue(*m_queues[victim]);
+		}
+		count(counters.m_successes, 1);
+		count(counters.m_tasks_stolen, stolen);
+		return true;
+	}
+
+	std::uint64_t steal_half_into_local_queue(WorkStealingQueue &victim)
+	{
+		const std::size_t batch = victim.size() / 2;
+		std::uint64_t stolen = 0;
+		function_wrapper task;
+		while ((stolen < batch) && victim.try_steal(task))
+		{
+			sm_local_work_queue->push(std::move(task));
+			++stolen;
+		}
+		return stolen;
+	}
+
+	worker_counters &my_counters()
+	{
+		return m_counters[(sm_local_work_queue != nullptr) ? sm_my_index : m_queues.size()];
+	}
+
+	timer_handle add_timer(std::chrono::steady_clock::time_point when, std::chrono::steady_clock::duration period, function_wrapper fn)
+	{
+		if (m_done)
+		{
+			throw pool_shutdown_error();
+		}
+
+		std::call_once(m_timer_thread_started, [this] { m_timer_thread = std::thread(&thread_pool::run_timer_thread, this); });
+		std::shared_ptr<timer_entry> entry;
+		{
+			std::lock_guard<std::mutex> lk(m_timer_mx);
+			entry = std::make_shared<timer_entry>(std::move(fn), m_timers.deadline_tick(when),
+				(period == std::chrono::steady_clock::duration::zero()) ? 0 : m_timers.period_ticks(period));
+			m_timers.insert(entry);
+		}
+		m_timer_cv.notify_one();
+		return timer_handle(entry);
+	}
+
+	void run_timer_thread()
+	{
+		std::unique_lock<std::mutex> lk(m_timer_mx);
+		while (!m_done)
+		{
+			if (m_timers_due.load(std::memory_order_relaxed) || m_timers.empty())
+			{
+				m_timer_cv.wait(lk);
+				continue;
+			}
+
+			const std::chrono::steady_clock::time_point next = m_timers.tick_time(m_timers.next_expiry());
+			if ((m_timer_cv.wait_until(lk, next) == std::cv_status::timeout) || (std::chrono::steady_clock::now() >= next))
+			{
+				m_timers_due.store(true, std::memory_order_relaxed);
+				m_work_event.notify_one();
+			}
+		}
+	}
+
+	void service_timers()
+	{
+		std::vector<std::shared_ptr<timer_entry>> expired;
+		{
+			std::unique_lock<std::mutex> lk(m_timer_mx, std::try_to_lock);
+			if (!lk.owns_lock() || !m_timers_due.exchange(false, std::memory_order_relaxed))
+			{
+				return;
+			}
+			m_timers.advance(m_timers.now_tick(), expired);
+		}
+		m_timer_cv.notify_one();
+
+		for (auto &entry : expired)
+		{
+			if (entry->m_period != 0)
+			{
+				sm_local_work_queue->push([this, entry] { run_periodic(entry); });
+				continue;
+			}
+
+			int expected = timer_entry::pending;
+			if (entry->m_state.compare_exchange_strong(expected, timer_entry::fired, std::memory_order_acq_rel))
+			{
+				sm_local_work_queue->push(std::move(entry->m_fn));
+			}
+		}
+		if (expired.size() > 1)
+		{
+			m_work_event.notify_all();
+		}
+	}
+
+	void run_periodic(const std::shared_ptr<timer_entry> &entry)
+	{
+		if (entry->m_state.load(std::memory_order_acquire) != timer_entry::pending)
+		{
+			return;
+		}
+
+		entry->m_fn();
+		{
+			std::lock_guard<std::mutex> lk(m_timer_mx);
+			const std::uint64_t now = m_timers.now_tick();
+			do
+			{
+				entry->m_deadline += entry->m_period;
+			} while (entry->m_deadline <= now);
+			m_timers.insert(entry);
+		}
+		m_timer_cv.notify_one();
+	}
+
+	void account_idle(std::chrono::steady_clock::time_point &idle_mark)
+	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		count(my_counters().m_idle_ns, std::chrono::duration_cast<std::chrono::nanoseconds>(now - idle_mark).count());
+		idle_mark = now;
+	}
+
+	void count(std::atomic<std::uint64_t> &counter, std::uint64_t amount)
+	{
+		if (sm_local_work_queue != nullptr)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+		else
+		{
+			counter.fetch_add(amount, std::memory_order_relaxed);
+		}
+	}
+};
+
+template <typename WorkStealingQueue>
+thread_local WorkStealingQueue* thread_pool<WorkStealingQueue>::sm_local_work_queue = nullptr;
+template <typename WorkStealingQueue>
+thread_local unsigned thread_pool<WorkStealingQueue>::sm_my_index = 0;
+template <typename WorkStealingQueue>
+thread_local std::minstd_rand thread_pool<WorkStealingQueue>::sm_victim_random;
+
+template <typename WorkStealingQueue>
+thread_local unsigned thread_pool<WorkStealingQueue>::sm_local_streak = 0;
+
+template <typename ThreadPool>
+class task_group
+{
+public:
+	explicit task_group(ThreadPool &pool)
+		: m_pool(pool), m_pending(0), m_has_exception(false)
+	{
+
+	}
+
+	~task_group()
+	{
+		wait_for_children();
+	}
+
+	task_group(const task_group&) = delete;
+	task_group &operator=(const task_group&) = delete;
+
+	template <typename F>
+	void run(F f)
+	{
+		m_pending.fetch_add(1, std::memory_order_relaxed);
+		m_pool.schedule([this, f = std::move(f)]() mutable
+		{
+			try
+			{
+				f();
+			}
+			catch (...)
+			{
+				if (!m_has_exception.exchange(true, std::memory_order_acq_rel))
+				{
+					m_exception = std::current_exception();
+				}
+			}
+
+			if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				notify_task_completion(this);
+			}
+		});
+	}
+
+	void wait()
+	{
+		wait_for_children();
+		if (m_has_exception.load(std::memory_order_acquire))
+		{
+			std::exception_ptr exception = m_exception;
+			m_exception = nullptr;
+			m_has_exception.store(false, std::memory_order_relaxed);
+			std::rethrow_exception(exception);
+		}
+	}
+
+private:
+	ThreadPool &m_pool;
+	std::atomic<std::size_t> m_pending;
+	std::atomic<bool> m_has_exception;
+	std::exception_ptr m_exception;
+
+	void wait_for_children()
+	{
+		m_pool.help_until([this] { return m_pending.load(std::memory_order_acquire) == 0; }, task_completion_event(this));
+	}
+};
+
+template <typename ThreadPool>
+class stats_reporter
+{
+public:
+	stats_reporter(ThreadPool &pool, std::ostream &out, std::chrono::milliseconds interval)
+		: m_pool(pool), m_out(out), m_interval(interval), m_done(false), m_thread(&stats_reporter::report, this)
+	{
+
+	}
+
+	stats_reporter(const stats_reporter&) = delete;
+	stats_reporter &operator=(const stats_reporter&) = delete;
+
+	~stats_reporter()
+	{
+		{
+			std::lock_guard<std::mutex> lk(m_mx);
+			m_done = true;
+		}
+		m_cv.notify_all();
+		m_thread.join();
+	}
+
+private:
+	ThreadPool &m_pool;
+	std::ostream &m_out;
+	const std::chrono::milliseconds m_interval;
+	bool m_done;
+	std::mutex m_mx;
+	std::condition_variable m_cv;
+	std::thread m_thread;
+
+	void report()
+	{
+		std::unique_lock<std::mutex> lk(m_mx);
+		while (!m_cv.wait_for(lk, m_interval, [this] { return m_done; }))
+		{
+			write_json(m_out, m_pool.stats()) << std::endl;
+		}
+	}
+};
+
+template <typename T>
+class task;
+
+template <typename T>
+class spawned_task;
+
+class task_promise_base
+{
+public:
+	static void *operator new(std::size_t size)
+	{
+		return allocate_task_state(size);
+	}
+
+	static void operator delete(void *memory, std::size_t size)
+	{
+		deallocate_task_state(memory, size);
+	}
+
+	class final_awaiter
+	{
+	public:
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			task_promise_base &promise = handle.promise();
+			void *const continuation = promise.m_continuation.exchange(finished(), std::memory_order_acq_rel);
+			if (continuation != nullptr)
+			{
+				return std::coroutine_handle<>::from_address(continuation);
+			}
+
+			notify_task_completion(&promise);
+			return std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept
+		{
+
+		}
+	};
+
+	std::suspend_always initial_suspend() const noexcept
+	{
+		return {};
+	}
+
+	final_awaiter final_suspend() const noexcept
+	{
+		return {};
+	}
+
+	void unhandled_exception() noexcept
+	{
+		m_exception = std::current_exception();
+	}
+
+	bool set_continuation(std::coroutine_handle<> continuation) noexcept
+	{
+		void *expected = nullptr;
+		return m_continuation.compare_exchange_strong(expected, continuation.address(), std::memory_order_acq_rel);
+	}
+
+	bool is_ready() const noexcept
+	{
+		return m_continuation.load(std::memory_order_acquire) == finished();
+	}
+
+protected:
+	std::exception_ptr m_exception;
+
+	void rethrow_if_failed() const
+	{
+		if (m_exception)
+		{
+			std::rethrow_exception(m_exception);
+		}
+	}
+
+private:
+	std::atomic<void*> m_continuation{ nullptr };
+
+	static void *finished() noexcept
+	{
+		static char marker;
+		return &marker;
+	}
+};
+
+template <typename T>
+class task_promise : public task_promise_base
+{
+public:
+	task<T> get_return_object() noexcept;
+
+	template <typename U>
+	void return_value(U &&value)
+	{
+		m_value.emplace(std::forward<U>(value));
+	}
+
+	T result()
+	{
+		rethrow_if_failed();
+		return std::move(*m_value);
+	}
+
+private:
+	std::optional<T> m_value;
+};
+
+template <>
+class task_promise<void> : public task_promise_base
+{
+public:
+	task<void> get_return_object() noexcept;
+
+	void return_void() noexcept
+	{
+
+	}
+
+	void result()
+	{
+		rethrow_if_failed();
+	}
+};
+
+template <typename T>
+class task
+{
+public:
+	using promise_type = task_promise<T>;
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	class awaiter
+	{
+	public:
+		explicit awaiter(handle_type handle)
+			: m_handle(handle)
+		{
+
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+		{
+			m_handle.promise().set_continuation(continuation);
+			return m_handle;
+		}
+
+		T await_resume()
+		{
+			return m_handle.promise().result();
+		}
+
+	private:
+		handle_type m_handle;
+	};
+
+	explicit task(handle_type handle)
+		: m_handle(handle)
+	{
+
+	}
+
+	task(task &&other) noexcept
+		: m_handle(std::exchange(other.m_handle, nullptr))
+	{
+
+	}
+
+	task(const task&) = delete;
+	task &operator=(const task&) = delete;
+	task &operator=(task&&) = delete;
+
+	~task()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+		}
+	}
+
+	awaiter operator co_await() && noexcept
+	{
+		return awaiter(m_handle);
+	}
+
+	handle_type release() noexcept
+	{
+		return std::exchange(m_handle, nullptr);
+	}
+
+private:
+	handle_type m_handle;
+};
+
+template <typename T>
+task<T> task_promise<T>::get_return_object() noexcept
+{
+	return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object() noexcept
+{
+	return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+template <typename T>
+class spawned_task
+{
+public:
+	using handle_type = std::coroutine_handle<task_promise<T>>;
+
+	class awaiter
+	{
+	public:
+		explicit awaiter(handle_type handle)
+			: m_handle(handle)
+		{
+
+		}
+
+		bool await_ready() const noexcept
+		{
+			return m_handle.promise().is_ready();
+		}
+
+		bool await_suspend(std::coroutine_handle<> continuation) noexcept
+		{
+			return m_handle.promise().set_continuation(continuation);
+		}
+
+		T await_resume()
+		{
+			return m_handle.promise().result();
+		}
+
+	private:
+		handle_type m_handle;
+	};
+
+	explicit spawned_task(handle_type handle)
+		: m_handle(handle)
+	{
+
+	}
+
+	spawned_task(spawned_task &&other) noexcept
+		: m_handle(std::exchange(other.m_handle, nullptr))
+	{
+
+	}
+
+	spawned_task(const spawned_task&) = delete;
+	spawned_task &operator=(const spawned_task&) = delete;
+	spawned_task &operator=(spawned_task&&) = delete;
+
+	~spawned_task()
+	{
+		if (m_handle)
+		{
+			wait();
+			m_handle.destroy();
+		}
+	}
+
+	bool is_ready() const noexcept
+	{
+		return m_handle.promise().is_ready();
+	}
+
+	event_count &completion_event() const noexcept
+	{
+		const task_promise_base &promise = m_handle.promise();
+		return task_completion_event(&promise);
+	}
+
+	void wait() const
+	{
+		event_count &completion = completion_event();
+		while (!is_ready())
+		{
+			const unsigned epoch = completion.prepare_wait();
+			if (is_ready())
+			{
+				completion.cancel_wait();
+				break;
+			}
+
+			completion.wait(epoch);
+		}
+	}
+
+	T get()
+	{
+		wait();
+		return m_handle.promise().result();
+	}
+
+	awaiter operator co_await() noexcept
+	{
+		return awaiter(m_handle);
+	}
+
+private:
+	handle_type m_handle;
+};
+
+template <typename ThreadPool, typename T>
+spawned_task<T> spawn(ThreadPool &pool, task<T> work)
+{
+	const typename task<T>::handle_type handle = work.release();
+	pool.schedule(function_wrapper([handle] { handle.resume(); }));
+	return spawned_task<T>(handle);
+}
+
+template <typename ThreadPool, typename T>
+T sync_wait(ThreadPool &pool, task<T> work)
+{
+	spawned_task<T> running = spawn(pool, std::move(work));
+	pool.help_until([&running] { return running.is_ready(); }, running.completion_event());
+	return running.get();
+}
+
+template <typename T>
+class task_future_awaiter
+{
+public:
+	explicit task_future_awaiter(task_future<T> future)
+		: m_future(std::move(future))
+	{
+
+	}
+
+	bool await_ready() const
+	{
+		return m_future.is_ready();
+	}
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		m_future.then([this, handle](task_future<T> ready)
+		{
+			m_future = std::move(ready);
+			handle.resume();
+		});
+	}
+
+	T await_resume()
+	{
+		return m_future.get();
+	}
+
+private:
+	task_future<T> m_future;
+};
+
+template <typename T>
+task_future_awaiter<T> operator co_await(task_future<T> &&future)
+{
+	return task_future_awaiter<T>(std::move(future));
+}
+
+template <typename T, typename WorkStealingQueue = lock_free_work_stealing_queue>
+struct sorter
+{
+	thread_pool<WorkStealingQueue> m_tp;
+
+	std::list<T> do_sort(std::list<T> &chunk_data)
+	{
+		if (chunk_data.empty())
+		{
+			return chunk_data;
+		}
+
+		std::list<T> result;
+		result.splice(result.begin(), chunk_data, chunk_data.begin());
+		const T &partition_val = *result.begin();
+
+		typename std::list<T>::iterator divide_it = std::partition(chunk_data.begin(), chunk_data.end(),
+			[&](const T &val) { return val < partition_val; });
+		
+		std::list<T> new_lower_chunk;
+		new_lower_chunk.splice(new_lower_chunk.end(), chunk_data, chunk_data.begin(), divide_it);
+		std::list<T> new_lower;
+		std::list<T> new_higher;
+		m_tp.parallel_invoke(
+			[&] { new_higher = do_sort(chunk_data); },
+			[&] { new_lower = do_sort(new_lower_chunk); });
+
+		result.splice(result.end(), new_higher);
+		result.splice(result.begin(), new_lower);
+		return result;
+	}
+};
+
+template <typename T, typename WorkStealingQueue = lock_free_work_stealing_queue>
+std::list<T> parallel_quick_sort(std::list<T> input)
+{
+	if (input.empty())
+	{
+		return input;
+	}
+
+	sorter<T, WorkStealingQueue> s;
+	return s.do_sort(input);
+}
+
+task<int> ready_value()
+{
+	co_return 1;
+}
+
+task<long> count_chain(int length)
+{
+	long total = 0;
+	for (int index = 0; index < length; ++index)
+	{
+		total += co_await ready_value();
+	}
+	co_return total;
+}
+
+task<int> handle_request(thread_pool<> &pool, int request)
+{
+	co_await pool.schedule();
+	const int squared = co_await pool.submit([request] { return request * request; });
+	co_return squared + 1;
+}
+
+const unsigned fib_cutoff = 16;
+
+std::uint64_t serial_fib(unsigned n)
+{
+	return n < 2 ? n : serial_fib(n - 1) + serial_fib(n - 2);
+}
+
+task<std::uint64_t> coroutine_fib(thread_pool<> &pool, unsigned n)
+{
+	if (n < fib_cutoff)
+	{
+		co_return serial_fib(n);
+	}
+
+	spawned_task<std::uint64_t> left = spawn(pool, coroutine_fib(pool, n - 1));
+	const std::uint64_t right = co_await coroutine_fib(pool, n - 2);
+	co_return co_await left + right;
+}
+
+std::uint64_t future_fib(thread_pool<> &pool, unsigned n)
+{
+	if (n < fib_cutoff)
+	{
+		return serial_fib(n);
+	}
+
+	task_future<std::uint64_t> left = pool.submit([&pool, n] { return future_fib(pool, n - 1); });
+	const std::uint64_t right = future_fib(pool, n - 2);
+	pool.help_until([&left] { return left.is_ready(); }, left.completion_event());
+	return left.get() + right;
+}
+
+template <typename T>
+task<std::list<T>> coroutine_sort(thread_pool<> &pool, std::list<T> chunk_data)
+{
+	if (chunk_data.empty())
+	{
+		co_return chunk_data;
+	}
+
+	std::list<T> result;
+	result.splice(result.begin(), chunk_data, chunk_data.begin());
+	const T &partition_val = *result.begin();
+
+	typename std::list<T>::iterator divide_it = std::partition(chunk_data.begin(), chunk_data.end(),
+		[&](const T &val) { return val < partition_val; });
+
+	std::list<T> new_lower_chunk;
+	new_lower_chunk.splice(new_lower_chunk.end(), chunk_data, chunk_data.begin(), divide_it);
+	spawned_task<std::list<T>> new_lower = spawn(pool, coroutine_sort(pool, std::move(new_lower_chunk)));
+	std::list<T> new_higher = co_await coroutine_sort(pool, std::move(chunk_data));
+
+	result.splice(result.end(), new_higher);
+	result.splice(result.begin(), co_await new_lower);
+	co_return result;
+}
+
+int main()
+{
+	thread_pool<> pool;
+
+	const int chain_length = 10000;
+	std::cout << "chain of " << chain_length << " ready awaits: " << sync_wait(pool, count_chain(chain_length)) << std::endl;
+	std::cout << "handle_request(6): " << sync_wait(pool, handle_request(pool, 6)) << std::endl;
+
+	const unsigned fib_n = 35;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const std::uint64_t coroutine_result = sync_wait(pool, coroutine_fib(pool, fib_n));
+	const std::chrono::steady_clock::duration coroutine_time = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	const std::uint64_t future_result = future_fib(pool, fib_n);
+	const std::chrono::steady_clock::duration future_time = std::chrono::steady_clock::now() - start;
+
+	std::cout << "fib(" << fib_n << ") coroutine: " << coroutine_result << " in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(coroutine_time).count() << "ms, future: "
+		<< future_result << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(future_time).count() << "ms" << std::endl;
+
+	std::list<int> data;
+	std::default_random_engine e(static_cast<unsigned>(std::time(nullptr)));
+	std::uniform_int_distribution<int> u(0, 1000000);
+	for (int index = 0; index < 200000; ++index)
+	{
+		data.push_back(u(e));
+	}
+
+	start = std::chrono::steady_clock::now();
+	std::list<int> coroutine_sorted = sync_wait(pool, coroutine_sort(pool, data));
+	const std::chrono::steady_clock::duration coroutine_sort_time = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	std::list<int> future_sorted = parallel_quick_sort(data);
+	const std::chrono::steady_clock::duration future_sort_time = std::chrono::steady_clock::now() - start;
+
+	std::cout << "quicksort of " << data.size() << " ints coroutine: "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(coroutine_sort_time).count() << "ms (sorted "
+		<< std::is_sorted(coroutine_sorted.begin(), coroutine_sorted.end()) << "), parallel_invoke: "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(future_sort_time).count() << "ms (sorted "
+		<< std::is_sorted(future_sorted.begin(), future_sorted.end()) << ")" << std::endl;
+
+	return 0;
+}
\ No newline at end of file